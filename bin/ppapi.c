@@ -33,6 +33,7 @@
 
 #include <vlc_ppapi.h>
 
+#include "../src/ppapi.h"
 #include "../src/modules/modules.h"
 #include "../lib/media_player_internal.h"
 
@@ -64,11 +65,15 @@ VLC_PPAPI_MODULE_NAME("vlc");
 
 #undef PLUGIN_INIT_SYMBOL
 
+// Modules built as part of this project, see src/:
+int vlc_entry__ppapi_document(int (*)(void*, void*, int, ...), void*);
+
 #define PLUGIN_INIT_SYMBOL(name)                \
   CONCATENATE(vlc_entry, name),
 
 vlc_plugin_cb vlc_static_modules[] = {
 #include "vlc_static_modules_init.h"
+  vlc_entry__ppapi_document,
   NULL
 };
 #undef PLUGIN_INIT_SYMBOL
@@ -104,6 +109,19 @@ typedef struct instance_t {
   libvlc_media_player_t* media_player;
   libvlc_media_list_player_t* media_list_player;
   libvlc_media_list_t* playlist;
+
+  // inputs to, and the result of, the thread budget (see rebalance_threads):
+  bool focused;
+  bool visible;
+  int64_t area;
+  unsigned threads;
+
+  // `memory-budget`, in bytes; 0 if none.
+  int64_t memory_budget;
+
+  // `stats`, in ticks; 0 if the page didn't ask for them.
+  unsigned stats_period;
+  unsigned stats_countdown;
 } instance_t;
 
 // the array of instances is stored after instances_t in memory.
@@ -121,6 +139,8 @@ static instances_t* g_instances = NULL;
 #define CHECKMALLOC(msg, var, ret) if (unlikely(var == NULL)) { printf("`%s` returned null!", msg); return (ret); } true
 #define NULLABORT(msg, var) if (unlikely((var) == NULL)) { printf("`%s` returned null! Aborting! (" __FILE__ ":" __LINE__ ")", msg); abort(); } true
 
+static void detach_player_events(instance_t* instance);
+
 static instance_t* get_instance(PP_Instance inst) {
   if(g_instances == NULL) {
     return NULL;
@@ -155,6 +175,13 @@ static instance_t* add_instance(PP_Instance pp_inst) {
   new_array[new_idx].media_player = NULL;
   new_array[new_idx].media_list_player = NULL;
   new_array[new_idx].playlist = NULL;
+  new_array[new_idx].focused = false;
+  new_array[new_idx].visible = true;
+  new_array[new_idx].area = 0;
+  new_array[new_idx].threads = 0;
+  new_array[new_idx].memory_budget = 0;
+  new_array[new_idx].stats_period = 0;
+  new_array[new_idx].stats_countdown = 0;
 
   instances_t* old_instances = g_instances;
   g_instances = new_instances;
@@ -181,19 +208,24 @@ static PP_Bool remove_instance(instance_t* instance) {
   if(new_instances->count != 0) {
     const size_t slice_start = (size_t)(instance - cur_array);
     const size_t slice_end   = slice_start + 1;
-    memmove(new_array, cur_array, (size_t)(instance - cur_array));
-    memmove((uint8_t*)new_array + slice_start,
-            (uint8_t*)cur_array + slice_end,
-            new_bytes - slice_end);
+    memmove(new_array, cur_array, sizeof(instance_t) * slice_start);
+    memmove(new_array + slice_start, cur_array + slice_end,
+            sizeof(instance_t) * (new_instances->count - slice_start));
   }
 
   instances_t* old_instances = g_instances;
   g_instances = new_instances;
+  if(new_instances->count == 0) {
+    // get_instance expects a NULL registry when there are no instances.
+    free(new_instances);
+    g_instances = NULL;
+  }
 
   if(instance->vlc != NULL) {
     libvlc_release(instance->vlc);
   }
   if(instance->media_player != NULL) {
+    detach_player_events(instance);
     libvlc_media_player_release(instance->media_player);
   }
   if(instance->media_list_player != NULL) {
@@ -203,9 +235,270 @@ static PP_Bool remove_instance(instance_t* instance) {
     libvlc_media_list_release(instance->playlist);
   }
 
+  vlc_PPAPI_DeinitializeInstance(instance->pp);
+
   free(old_instances);
 
-  return PP_OK;
+  return PP_TRUE;
+}
+
+// Decoder thread budget. NaCl exposes every core to every embed, so instead of
+// letting each libavcodec size its pool to the whole machine, the module hands
+// out one shared budget (every core but one, which is left to the browser).
+// Every instance gets a thread; the rest go to visible instances in priority
+// order (focused first, then largest), a focused instance taking two per round.
+// The result lands in the player's `avcodec-threads`, which decoders inherit
+// when they are opened, and is reported as `decoder_threads` in the stats.
+// MAY ONLY BE CALLED FROM THE MAIN THREAD, same as `g_instances`.
+static unsigned thread_budget(void) {
+  const unsigned cpus = vlc_GetCPUCount();
+  return cpus > 1 ? cpus - 1 : 1;
+}
+
+static int instance_priority_cmp(const void* l, const void* r) {
+  const instance_t* a = *(instance_t* const*)l;
+  const instance_t* b = *(instance_t* const*)r;
+
+  if(a->visible != b->visible) { return a->visible ? -1 : 1; }
+  if(a->focused != b->focused) { return a->focused ? -1 : 1; }
+  if(a->area != b->area) { return a->area > b->area ? -1 : 1; }
+  return 0;
+}
+
+static void rebalance_threads(void) {
+  if(g_instances == NULL || g_instances->count == 0) { return; }
+
+  const size_t count = g_instances->count;
+  instance_t* instances = get_instances_array(g_instances);
+
+  instance_t** by_priority = alloca(sizeof(instance_t*) * count);
+  unsigned* previous = alloca(sizeof(unsigned) * count);
+  size_t visible = 0;
+  for(size_t i = 0; i < count; i++) {
+    by_priority[i] = &instances[i];
+    previous[i] = instances[i].threads;
+    instances[i].threads = 1;
+    if(instances[i].visible) { visible++; }
+  }
+  qsort(by_priority, count, sizeof(instance_t*), instance_priority_cmp);
+
+  const unsigned budget = thread_budget();
+  unsigned spare = budget > count ? budget - (unsigned)count : 0;
+  while(spare != 0 && visible != 0) {
+    for(size_t i = 0; i < visible && spare != 0; i++) {
+      instance_t* inst = by_priority[i];
+      const unsigned share = inst->focused && spare > 1 ? 2 : 1;
+      inst->threads += share;
+      spare -= share;
+    }
+  }
+
+  // this runs on every DidChangeView (ie scrolling), so only touch the players
+  // whose share changed.
+  for(size_t i = 0; i < count; i++) {
+    instance_t* inst = &instances[i];
+    if(inst->media_player == NULL || inst->threads == previous[i]) { continue; }
+
+    var_SetInteger(inst->media_player, "avcodec-threads", inst->threads);
+    msg_Dbg(inst->media_player, "decoder thread budget: %u of %u (%zu instance(s))",
+            inst->threads, budget, count);
+  }
+}
+
+// Prebuffering used while the module is close to its memory budget (see
+// `memory-budget` in vlc_did_create), in milliseconds. Inputs read these when
+// they start, so only those started under pressure get the smaller buffers.
+#define PRESSURE_NETWORK_CACHING 300
+#define PRESSURE_FILE_CACHING 100
+
+static void memory_pressure_changed(instance_t* instance, bool pressure) {
+  if(instance->media_player == NULL) { return; }
+
+  libvlc_int_t* libvlc = instance->vlc->p_libvlc_int;
+  if(pressure) {
+    msg_Warn(instance->media_player, "close to the memory budget, shrinking prebuffering of new inputs");
+    var_SetInteger(instance->media_player, "network-caching", PRESSURE_NETWORK_CACHING);
+    var_SetInteger(instance->media_player, "file-caching", PRESSURE_FILE_CACHING);
+  } else {
+    msg_Dbg(instance->media_player, "memory pressure relieved, restoring prebuffering");
+    var_SetInteger(instance->media_player, "network-caching",
+                   var_InheritInteger(libvlc, "network-caching"));
+    var_SetInteger(instance->media_player, "file-caching",
+                   var_InheritInteger(libvlc, "file-caching"));
+  }
+}
+
+// Every instance shares the heap, so the tightest budget applies to all.
+static void sample_memory(void) {
+  const size_t count = g_instances->count;
+  instance_t* instances = get_instances_array(g_instances);
+
+  int64_t budget = 0;
+  for(size_t i = 0; i < count; i++) {
+    const int64_t b = instances[i].memory_budget;
+    if(b != 0 && (budget == 0 || b < budget)) { budget = b; }
+  }
+
+  if(!vlc_ppapi_mem_sample(budget)) { return; }
+
+  const bool pressure = vlc_ppapi_mem_under_pressure();
+  for(size_t i = 0; i < count; i++) {
+    memory_pressure_changed(&instances[i], pressure);
+  }
+}
+
+static int queue_depth(int in, int out, int lost) {
+  return in > out + lost ? in - out - lost : 0;
+}
+
+// The `stats` message: what libvlc counts for the current media, the counters
+// of src/ppapi-stats.c, the bandwidth estimate, the decoder threads allotted by
+// rebalance_threads, and the heap usage.
+static void post_stats(instance_t* instance) {
+  VLC_PPAPI_STATIC_STR(type_key, "type");
+  VLC_PPAPI_STATIC_STR(type_stats, "stats");
+  VLC_PPAPI_STATIC_STR(stats_key, "stats");
+  VLC_PPAPI_STATIC_STR(memory_key, "memory");
+  VLC_PPAPI_STATIC_STR(bandwidth_key, "bandwidth");
+  VLC_PPAPI_STATIC_STR(decoder_threads_key, "decoder_threads");
+
+  if(instance->media_player == NULL) { return; }
+
+  PP_Var stats = vlc_ppapi_stats_to_var(vlc_ppapi_get_stats(instance->pp));
+  if(stats.type != PP_VARTYPE_DICTIONARY) { return; }
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+
+  libvlc_media_stats_t media_stats;
+  memset(&media_stats, 0, sizeof(media_stats));
+  libvlc_media_t* media = libvlc_media_player_get_media(instance->media_player);
+  if(media != NULL) {
+    libvlc_media_get_stats(media, &media_stats);
+    libvlc_media_release(media);
+  }
+
+  const struct {
+    const char* name;
+    int value;
+  } counters[] = {
+    { "frames_decoded", media_stats.i_decoded_video },
+    { "frames_displayed", media_stats.i_displayed_pictures },
+    { "frames_lost", media_stats.i_lost_pictures },
+    { "audio_decoded", media_stats.i_decoded_audio },
+    { "audio_played", media_stats.i_played_abuffers },
+    { "audio_lost", media_stats.i_lost_abuffers },
+    { "read_bytes", media_stats.i_read_bytes },
+    { "demux_read_bytes", media_stats.i_demux_read_bytes },
+    { "demux_corrupted", media_stats.i_demux_corrupted },
+    { "demux_discontinuity", media_stats.i_demux_discontinuity },
+    // decoded but neither output nor dropped yet, ie what's queued between the
+    // decoders and the outputs. The decoders' input and the demuxer's output
+    // aren't counted by libvlc.
+    { "video_queue", queue_depth(media_stats.i_decoded_video, media_stats.i_displayed_pictures,
+                                 media_stats.i_lost_pictures) },
+    { "audio_queue", queue_depth(media_stats.i_decoded_audio, media_stats.i_played_abuffers,
+                                 media_stats.i_lost_abuffers) },
+  };
+  for(size_t i = 0; i < ARRAY_SIZE(counters); i++) {
+    PP_Var key = vlc_ppapi_cstr_to_var(counters[i].name, strlen(counters[i].name));
+    idict->Set(stats, key, PP_MakeDouble((double)counters[i].value));
+    vlc_ppapi_deref_var(key);
+  }
+
+  idict->Set(stats, vlc_ppapi_mk_str(&bandwidth_key),
+             PP_MakeDouble(vlc_ppapi_bandwidth_estimate(instance->pp)));
+  idict->Set(stats, vlc_ppapi_mk_str(&decoder_threads_key), PP_MakeInt32((int32_t)instance->threads));
+
+  PP_Var memory = vlc_ppapi_mem_stats();
+  idict->Set(stats, vlc_ppapi_mk_str(&memory_key), memory);
+  vlc_ppapi_deref_var(memory);
+
+  PP_Var msg = idict->Create();
+  idict->Set(msg, vlc_ppapi_mk_str(&type_key), vlc_ppapi_mk_str(&type_stats));
+  idict->Set(msg, vlc_ppapi_mk_str(&stats_key), stats);
+  vlc_getPPAPI_Messaging()->PostMessage(instance->pp, msg);
+  vlc_ppapi_deref_var(msg);
+  vlc_ppapi_deref_var(stats);
+}
+
+// Called from libvlc's event thread with the instance's stats handle, which is
+// valid as long as the events stay attached (see remove_instance).
+static void player_event(const libvlc_event_t* event, void* data) {
+  vlc_ppapi_stats_t* stats = data;
+
+  switch(event->type) {
+  case libvlc_MediaPlayerBuffering:
+    vlc_ppapi_stats_set(stats, VLC_PPAPI_STATS_CACHE_FILL,
+                        (int64_t)(event->u.media_player_buffering.new_cache * 10.0f));
+    break;
+  case libvlc_MediaPlayerStopped:
+  case libvlc_MediaPlayerEndReached:
+    // fails when not tracing, which is fine.
+    vlc_ppapi_trace_post(stats);
+    break;
+  default:
+    break;
+  }
+}
+
+static const libvlc_event_type_t g_player_events[] = {
+  libvlc_MediaPlayerBuffering,
+  libvlc_MediaPlayerStopped,
+  libvlc_MediaPlayerEndReached,
+};
+
+static void attach_player_events(instance_t* instance) {
+  libvlc_event_manager_t* events = libvlc_media_player_event_manager(instance->media_player);
+  vlc_ppapi_stats_t* stats = vlc_ppapi_get_stats(instance->pp);
+  for(size_t i = 0; i < ARRAY_SIZE(g_player_events); i++) {
+    libvlc_event_attach(events, g_player_events[i], player_event, stats);
+  }
+}
+
+// Waits for a callback that's already running, so no event is still in
+// flight once the instance data is gone.
+static void detach_player_events(instance_t* instance) {
+  libvlc_event_manager_t* events = libvlc_media_player_event_manager(instance->media_player);
+  vlc_ppapi_stats_t* stats = vlc_ppapi_get_stats(instance->pp);
+  for(size_t i = 0; i < ARRAY_SIZE(g_player_events); i++) {
+    libvlc_event_detach(events, g_player_events[i], player_event, stats);
+  }
+}
+
+// Housekeeping, run on the main thread every TICK_MS for as long as there are
+// instances.
+#define TICK_MS 1000
+
+static bool g_tick_scheduled = false;
+
+static void tick(void* user_data, int32_t result);
+
+static void schedule_tick(void) {
+  if(g_tick_scheduled || g_instances == NULL) { return; }
+
+  vlc_getPPAPI_Core()->CallOnMainThread(TICK_MS, PP_MakeCompletionCallback(tick, NULL), 0);
+  g_tick_scheduled = true;
+}
+
+static void tick(void* user_data, int32_t result) {
+  VLC_UNUSED(user_data); VLC_UNUSED(result);
+
+  g_tick_scheduled = false;
+  if(g_instances == NULL) { return; }
+
+  sample_memory();
+
+  const size_t count = g_instances->count;
+  instance_t* instances = get_instances_array(g_instances);
+  for(size_t i = 0; i < count; i++) {
+    instance_t* instance = &instances[i];
+    if(instance->stats_period == 0 || --instance->stats_countdown != 0) { continue; }
+
+    instance->stats_countdown = instance->stats_period;
+    post_stats(instance);
+  }
+
+  schedule_tick();
 }
 
 PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface);
@@ -217,7 +510,9 @@ int32_t PPP_InitializeModule(PP_Module mod, PPB_GetInterface get_interface) {
     return PP_FALSE;
   }
 
-  if(!glInitializePPAPI(get_interface)) {
+  // the hooked interfaces, so the video output's texture uploads are traced
+  // (see src/ppapi-hooks.c).
+  if(!glInitializePPAPI(vlc_getPPBGetInstance())) {
     printf("failed to initialize ppapi gles2 interface");
     abort();
     return PP_FALSE;
@@ -226,8 +521,15 @@ int32_t PPP_InitializeModule(PP_Module mod, PPB_GetInterface get_interface) {
   }
 }
 
-// There's no need to implement this. All resources are force-freed by the sandbox when it exits.
-void PPP_ShutdownModule() {}
+// The sandbox force-frees everything when it exits, but tear down the
+// instances anyway so their inputs are stopped cleanly.
+void PPP_ShutdownModule() {
+  while(g_instances != NULL) {
+    if(remove_instance(get_instances_array(g_instances)) == PP_FALSE) {
+      break;
+    }
+  }
+}
 
 const void* PPP_GetInterface(const char* interface_name) {
   if(strcmp(interface_name, "PPP_Instance;1.1") == 0) {
@@ -237,17 +539,48 @@ const void* PPP_GetInterface(const char* interface_name) {
   }
 }
 
-// TODO don't leak shit.
-static PP_Bool vlc_did_create(PP_Instance instance, uint32_t _argc,
-                              const char *_argn[], const char *_argv[]) {
+// Trace ring size used when `trace` isn't given a number.
+#define DEFAULT_TRACE_EVENTS (64 * 1024)
+
+// Recognized <embed> attributes:
+//  * `input-events`: post the `transfer` and `bandwidth` input events (see
+//    src/ppapi-hooks.c).
+//  * `memory-budget`: soft high-water mark, in MiB, of the module's heap (the
+//    smallest of every instance's). Close to it, inputs started from then on
+//    prebuffer less; nothing is enforced per instance.
+//  * `stats`: post a `stats` message (see post_stats) every `stats` seconds
+//    (or every second if it isn't a number).
+//  * `trace`: record trace spans, keeping the last `trace` events (or
+//    DEFAULT_TRACE_EVENTS if it isn't a number). The trace is posted whenever
+//    playback stops or reaches its end.
+static PP_Bool vlc_did_create(PP_Instance instance, uint32_t argc,
+                              const char *argn[], const char *argv[]) {
   vlc_setPPAPI_InitializingInstance(instance);
 
-  VLC_UNUSED(_argc); VLC_UNUSED(_argn); VLC_UNUSED(_argv);
-
   if(vlc_PPAPI_InitializeInstance(instance) != VLC_SUCCESS) {
     return PP_FALSE;
   }
 
+  int64_t memory_budget = 0;
+  unsigned stats_period = 0;
+  for(uint32_t i = 0; i < argc; i++) {
+    if(strcmp(argn[i], "input-events") == 0) {
+      vlc_ppapi_input_events_enable(instance);
+    } else if(strcmp(argn[i], "memory-budget") == 0) {
+      const long long mib = strtoll(argv[i], NULL, 10);
+      if(mib > 0) {
+        memory_budget = (int64_t)mib * 1024 * 1024;
+      }
+    } else if(strcmp(argn[i], "stats") == 0) {
+      const long long seconds = strtoll(argv[i], NULL, 10);
+      stats_period = seconds > 0 ? (unsigned)(seconds * 1000 / TICK_MS) : 1;
+    } else if(strcmp(argn[i], "trace") == 0) {
+      const long long events = strtoll(argv[i], NULL, 10);
+      vlc_ppapi_trace_enable(vlc_ppapi_get_stats(instance),
+                             events > 0 ? (size_t)events : DEFAULT_TRACE_EVENTS);
+    }
+  }
+
   PP_Bool ret = PP_FALSE;
 
   libvlc_instance_t* vlc_inst = NULL;
@@ -258,8 +591,12 @@ static PP_Bool vlc_did_create(PP_Instance instance, uint32_t _argc,
   instance_t* new_inst = add_instance(instance);
   if(new_inst == NULL) {
     vlc_ppapi_log_error(instance, "failed to create the plugin instance object!\n");
+    vlc_PPAPI_DeinitializeInstance(instance);
     goto error;
   }
+  new_inst->memory_budget = memory_budget;
+  new_inst->stats_period = stats_period;
+  new_inst->stats_countdown = stats_period;
 
   vlc_inst = libvlc_new(0, NULL);
   if(vlc_inst == NULL) {
@@ -269,7 +606,10 @@ static PP_Bool vlc_did_create(PP_Instance instance, uint32_t _argc,
     new_inst->vlc = vlc_inst;
   }
 
-  libvlc_log_set(vlc_inst, libvlc_logging_callback, (void*)new_inst);
+  // Not `new_inst`: the registry moves whenever an instance is added or
+  // removed. The stats handle outlives vlc_inst (see remove_instance), and
+  // saves looking it up for every line.
+  libvlc_log_set(vlc_inst, libvlc_logging_callback, vlc_ppapi_get_stats(instance));
 
   media_player = libvlc_media_player_new(vlc_inst);
   if(media_player == NULL) {
@@ -278,15 +618,25 @@ static PP_Bool vlc_did_create(PP_Instance instance, uint32_t _argc,
   } else {
     new_inst->media_player = media_player;
   }
+  attach_player_events(new_inst);
   var_Create(media_player, "ppapi-instance", VLC_VAR_INTEGER);
   var_SetInteger(media_player, "ppapi-instance", instance);
   var_SetString(media_player, "vout", "ppapi_vout_graphics3d");
+  var_Create(media_player, "avcodec-threads", VLC_VAR_INTEGER);
+  var_Create(media_player, "network-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT);
+  var_Create(media_player, "file-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT);
+  if(vlc_ppapi_mem_under_pressure()) {
+    memory_pressure_changed(new_inst, true);
+  }
 
   if(-1 == libvlc_add_intf(vlc_inst, "ppapi_control")) {
     vlc_ppapi_log_error(instance, "failed to start `ppapi-control`");
     goto error;
   }
 
+  rebalance_threads();
+  schedule_tick();
+
   ret = PP_TRUE;
   goto done;
 
@@ -306,10 +656,18 @@ static void vlc_did_destroy(PP_Instance pp) {
   instance_t* instance = get_instance(pp);
   if (instance == NULL) { return; /* TODO: log */ }
 
+  // a document load whose access never got to open is still parked.
+  const PP_Resource loader = vlc_ppapi_take_document_loader(pp);
+  if(loader != 0) {
+    vlc_subResReference(loader);
+  }
+
   if(remove_instance(instance) == PP_FALSE) {
     assert(PP_FALSE && "failed to remove an instance");
     return;
   }
+
+  rebalance_threads();
 }
 
 static void vlc_did_change_view(PP_Instance pp, PP_Resource v) {
@@ -317,7 +675,20 @@ static void vlc_did_change_view(PP_Instance pp, PP_Resource v) {
   if(instance == NULL) { return; }
   msg_Dbg(instance->media_player, "Instance changed its viewport");
 
+  vlc_ppapi_stats_t* stats = vlc_ppapi_get_stats(pp);
+  const mtime_t span = vlc_ppapi_trace_begin(stats);
+
+  const vlc_ppapi_view_t* iview = vlc_getPPAPI_View();
+  struct PP_Rect rect;
+  instance->visible = iview->IsVisible(v) == PP_TRUE;
+  if(iview->GetRect(v, &rect) == PP_TRUE) {
+    instance->area = (int64_t)rect.size.width * (int64_t)rect.size.height;
+  }
+
   vlc_setPPAPI_InstanceViewport(pp, v);
+
+  rebalance_threads();
+  vlc_ppapi_trace_end(stats, "did-change-view", span);
 }
 
 static void vlc_did_change_focus(PP_Instance pp, const PP_Bool focus) {
@@ -326,13 +697,43 @@ static void vlc_did_change_focus(PP_Instance pp, const PP_Bool focus) {
   msg_Dbg(instance->media_player, "Instance changed focus to `%s`",
            focus == PP_TRUE ? "true" : "false");
 
+  vlc_ppapi_stats_t* stats = vlc_ppapi_get_stats(pp);
+  const mtime_t span = vlc_ppapi_trace_begin(stats);
+
+  instance->focused = focus == PP_TRUE;
   vlc_setPPAPI_InstanceFocus(pp, focus);
+
+  rebalance_threads();
+  vlc_ppapi_trace_end(stats, "did-change-focus", span);
 }
 
+// We're the MIME handler of a full-frame navigation: the browser has already
+// started downloading the media, so play straight out of its loader (see
+// src/ppapi-document.c) instead of fetching everything a second time.
 static PP_Bool vlc_handle_document_load(PP_Instance pp, PP_Resource url_loader) {
-  VLC_UNUSED(pp);
-  VLC_UNUSED(url_loader);
-  return PP_FALSE;
+  instance_t* instance = get_instance(pp);
+  if(instance == NULL || instance->media_player == NULL) { return PP_FALSE; }
+
+  char mrl[sizeof("ppapi-document://") + 16];
+  snprintf(mrl, sizeof(mrl), "ppapi-document://%" PRId32, pp);
+
+  libvlc_media_t* media = libvlc_media_new_location(instance->vlc, mrl);
+  if(media == NULL) {
+    vlc_ppapi_log_error(pp, "failed to create the document media");
+    return PP_FALSE;
+  }
+
+  vlc_ppapi_set_document_loader(pp, url_loader);
+  libvlc_media_player_set_media(instance->media_player, media);
+  libvlc_media_release(media);
+
+  if(libvlc_media_player_play(instance->media_player) != 0) {
+    vlc_ppapi_log_error(pp, "failed to start playing the document");
+    vlc_subResReference(vlc_ppapi_take_document_loader(pp));
+    return PP_FALSE;
+  }
+
+  return PP_TRUE;
 }
 
 static PP_Var create_source_var(const libvlc_log_t* item) {
@@ -363,11 +764,16 @@ static PP_Var create_source_var(const libvlc_log_t* item) {
 static void libvlc_logging_callback(void* data, int libvlc_type,
                                     const libvlc_log_t* item,
                                     const char* format, va_list args) {
-  instance_t* inst = (instance_t*)data;
-  assert(inst != NULL);
+  vlc_ppapi_stats_t* stats = data;
+  const PP_Instance pp = vlc_ppapi_stats_instance(stats);
+
+  // filtered out, which isn't dropping it.
+  const int log_verbosity = vlc_getPPAPI_InstanceLogVerbosity(pp);
+  if(log_verbosity > libvlc_type) {
+    return;
+  }
 
-  const int log_verbosity = vlc_getPPAPI_InstanceLogVerbosity(inst->pp);
-  if(log_verbosity > libvlc_type) { return; }
+  const mtime_t span = vlc_ppapi_trace_begin(stats);
 
   PP_LogLevel level = PP_LOGLEVEL_ERROR;
   switch(libvlc_type) {
@@ -382,6 +788,7 @@ static void libvlc_logging_callback(void* data, int libvlc_type,
   const int buffer_size = vasprintf(&buffer, format, args);
   if(buffer_size < 0) {
     printf("failed to format log\n");
+    vlc_ppapi_stats_add(stats, VLC_PPAPI_STATS_LOG_DROPPED, 1);
     return;
   }
 
@@ -389,7 +796,8 @@ static void libvlc_logging_callback(void* data, int libvlc_type,
   free(buffer);
 
   PP_Var src = create_source_var(item);
-  vlc_getPPAPI_Console()->LogWithSource(inst->pp, level, src, msg);
+  vlc_getPPAPI_Console()->LogWithSource(pp, level, src, msg);
   vlc_ppapi_deref_var(msg);
   vlc_ppapi_deref_var(src);
+  vlc_ppapi_trace_end(stats, "log", span);
 }
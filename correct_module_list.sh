@@ -46,6 +46,26 @@ EOF
     fi;
 }
 
+# Native objects (ie not bitcode) are renamed with objcopy instead, which only
+# takes exact symbol names.
+create_redefine_symbol_list()
+{
+    local name=$1 entry=$2 copyright=$3 license=$4
+    for line in AccessOpen AccessClose StreamOpen StreamClose DemuxOpen DemuxClose OpenFilter CloseFilter Open Close;
+    do
+        echo "$line ${line}__$name" >> symbol_list;
+    done;
+    if [ ! "$entry" = "vlc_entry_$name" ]; then
+        echo "$entry vlc_entry__$name" >> symbol_list;
+    fi;
+    if [ ! -z $copyright ]; then
+        echo "$copyright vlc_entry_copyright__$name" >> symbol_list;
+    fi;
+    if [ ! -z $license ]; then
+        echo "$license vlc_entry_license__$name" >> symbol_list;
+    fi;
+}
+
 alter_library_symbols()
 {
     local file name entry copyright license
@@ -61,13 +81,21 @@ alter_library_symbols()
     checkfail "[$name]: couldn't create temporary folder"
     cd module_tmp_folder_$name;
 
-    create_replace_symbol_list $name $entry $copyright $license
+    if [ -z "$OBJCOPY" ]; then
+        create_replace_symbol_list $name $entry $copyright $license
+    else
+        create_redefine_symbol_list $name $entry $copyright $license
+    fi;
     ar x $file;
     checkfail "[$name]: couldn't extract archive"
     for obj_file in $(ls *.o | tr ' ' '\n');
     do
         echo " [$name]: update " $obj_file;
-        $OPT -S $obj_file | sed -rf symbol_list | $OPT - -o $obj_file.tmp;
+        if [ -z "$OBJCOPY" ]; then
+            $OPT -S $obj_file | sed -rf symbol_list | $OPT - -o $obj_file.tmp;
+        else
+            $OBJCOPY --redefine-syms=symbol_list $obj_file $obj_file.tmp;
+        fi;
         checkfail "[$name]: $obj_file failed on symbol renaming"
         mv $obj_file.tmp $obj_file;
     done;
@@ -11,8 +11,15 @@ VlcInstance = function (element) {
   // --- internal state vars ---
   var next_request_id = 0;
   var inflight_requests = [];
+  // when each in-flight request was posted, and the round trips since the
+  // last `stats` message, in milliseconds:
+  var request_times = [];
+  var latency = { count: 0, total: 0, max: 0 };
 
   var events = {};
+  // Input events the module posts itself, if the embed has an `input-events`
+  // attribute; ppapi-control has nothing to subscribe to for them.
+  var module_events = ["transfer", "bandwidth"];
 
   // --- internal state vars ---
 
@@ -36,6 +43,22 @@ VlcInstance = function (element) {
   this.ON_READY_EVENT = 0;
   // /Event IDs
 
+  function record_latency(ms) {
+    latency.count++;
+    latency.total += ms;
+    latency.max = Math.max(latency.max, ms);
+  }
+  // Merged into the `stats` message, then started over.
+  function take_latency() {
+    var result = {
+      "count": latency.count,
+      "mean": latency.count !== 0 ? latency.total / latency.count : 0,
+      "max": latency.max
+    };
+    latency = { count: 0, total: 0, max: 0 };
+    return result;
+  }
+
   function SendAsyncRequest(location, args, callback) {
     var request = {};
 
@@ -46,6 +69,7 @@ VlcInstance = function (element) {
     request.args = args;
     request.version = root.API_VERSION;
 
+    request_times[request.request_id] = performance.now();
     element.postMessage(request);
 
     inflight_requests[request.request_id] = callback;
@@ -61,7 +85,9 @@ VlcInstance = function (element) {
     request.args = args;
     request.version = root.API_VERSION;
 
+    var sent = performance.now();
     var response = element.postMessageAndAwaitResponse(request);
+    record_latency(performance.now() - sent);
     if(response.return_code >= 400) {
       if(on_error == null) {
         throw response.return_code;
@@ -129,7 +155,9 @@ VlcInstance = function (element) {
     var baseloc = get_base_loc(self) + "/event/";
     return function(loc, cb) {
       var fullloc = baseloc + loc + "()";
-      subscribe_to_event(fullloc);
+      if(module_events.indexOf(loc) === -1) {
+        subscribe_to_event(fullloc);
+      }
       var listeners = events[fullloc];
       if(listeners === undefined) {
         listeners =
@@ -143,7 +171,9 @@ VlcInstance = function (element) {
     var baseloc = get_base_loc(self) + "/event/";
     return function(loc, cb) {
       var fullloc = baseloc + loc + "()";
-      unsubscribe_from_event(fullloc);
+      if(module_events.indexOf(loc) === -1) {
+        unsubscribe_from_event(fullloc);
+      }
       var listeners = events[fullloc];
       if(listeners === undefined) {
         return false;
@@ -182,6 +212,12 @@ VlcInstance = function (element) {
         v(message);
       })
     } else if(message.data.type === 'return') {
+      var sent = request_times[message.data.request_id];
+      if(sent !== undefined) {
+        record_latency(performance.now() - sent);
+        delete request_times[message.data.request_id];
+      }
+
       var callback = inflight_requests[message.data.request_id];
       if(callback === undefined || callback === null) {
         if(message.data.return_code >= 400) {
@@ -204,6 +240,15 @@ VlcInstance = function (element) {
 
       callback(callback_msg);
       inflight_requests[message.data.request_id] = null;
+    } else if(message.data.type === 'stats') {
+      message.data.stats.message_latency = take_latency();
+      if(typeof root.sys.onstats === 'function') {
+        root.sys.onstats(message.data.stats);
+      }
+    } else if(message.data.type === 'trace') {
+      if(typeof root.sys.ontrace === 'function') {
+        root.sys.ontrace(message.data.trace);
+      }
     } else {
       console.warn("Recieved unknown message type: `" + message.data.type + "`");
     }
@@ -346,6 +391,11 @@ VlcInstance = function (element) {
       return local_async_send("purge_cache", undefined, callback);
     };
 
+    // Called with the stats object, if the embed has a `stats` attribute.
+    this.onstats = null;
+    // Called with the trace JSON, if the embed has a `trace` attribute.
+    this.ontrace = null;
+
     return this;
   }
   this.sys = new Sys(this);
@@ -365,6 +415,7 @@ VlcInstance = function (element) {
     if(vlc_version === undefined) {
       initial_request_queue.push(request);
     } else {
+      request_times[request.request_id] = performance.now();
       element.postMessage(request);
     }
 
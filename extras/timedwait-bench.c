@@ -0,0 +1,202 @@
+/**
+ * @file timedwait-bench.c
+ * @brief Wakeup jitter of src/ppapi-timer.c vs realtime-translated waits.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Runs on the host (or as a plain NaCl nexe); doesn't need vlc:
+//
+//   cc -O2 -pthread -DPPAPI_TIMER_POSIX -Isrc -o timedwait-bench
+//      extras/timedwait-bench.c src/ppapi-timer.c
+//   ./timedwait-bench [-t threads] [-n waits] [-j jump_ms]
+//
+// Every thread does `waits` timed waits on its own condition variable, nobody
+// ever signaling it, each until a random deadline 1 to 20ms away, and records
+// how late (or early) it woke up. That is done once through
+// vlc_ppapi_cond_timedwait(), and once the way vlc does it without clock
+// selection: the monotonic deadline translated to realtime, then
+// pthread_cond_timedwait().
+//
+// Stepping the system clock needs root, so `-j` simulates it instead: every
+// fourth wait acts as if the realtime clock had been set back by `jump_ms`
+// right after the translation, which is exactly what such a step does to that
+// wait. vlc_ppapi_cond_timedwait() translates too, but its timer threads wake
+// the waiter up shortly after the deadline regardless.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ppapi-timer.h"
+
+#define MIN_DELAY 1000  // microseconds
+#define MAX_DELAY 20000
+
+typedef enum mode_t {
+  MODE_MONOTONIC,
+  MODE_TRANSLATED,
+} bench_mode_t;
+
+typedef struct bench_thread_t {
+  pthread_t thread;
+  bench_mode_t mode;
+  size_t waits;
+  int64_t jump;
+  unsigned seed;
+  int64_t* errors;
+} bench_thread_t;
+
+static int translated_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex,
+                                int64_t deadline, int64_t jump) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t rt = (int64_t)now.tv_sec * INT64_C(1000000) + now.tv_nsec / 1000;
+  rt += deadline - vlc_ppapi_mdate() + jump;
+
+  const struct timespec ts = {
+    .tv_sec = rt / INT64_C(1000000),
+    .tv_nsec = (long)(rt % INT64_C(1000000)) * 1000,
+  };
+  return pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+static void* bench_thread(void* data) {
+  bench_thread_t* t = data;
+
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+  pthread_mutex_lock(&mutex);
+  for(size_t i = 0; i < t->waits; i++) {
+    const int64_t delay = MIN_DELAY + rand_r(&t->seed) % (MAX_DELAY - MIN_DELAY);
+    const int64_t deadline = vlc_ppapi_mdate() + delay;
+    const int64_t jump = i % 4 == 3 ? t->jump : 0;
+
+    // loop over spurious wakeups, like vlc's callers do.
+    int err = 0;
+    while(err != ETIMEDOUT) {
+      if(t->mode == MODE_MONOTONIC) {
+        vlc_ppapi_realtime_skew = jump;
+        err = vlc_ppapi_cond_timedwait(&cond, &mutex, deadline);
+      } else {
+        err = translated_timedwait(&cond, &mutex, deadline, jump);
+      }
+    }
+
+    t->errors[i] = vlc_ppapi_mdate() - deadline;
+  }
+  pthread_mutex_unlock(&mutex);
+
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+  return NULL;
+}
+
+static int cmp_int64(const void* a, const void* b) {
+  const int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int run(const char* name, bench_mode_t mode, size_t threads, size_t waits,
+               int64_t jump) {
+  const size_t total = threads * waits;
+  int64_t* errors = malloc(total * sizeof(int64_t));
+  bench_thread_t* ts = calloc(threads, sizeof(bench_thread_t));
+  if(errors == NULL || ts == NULL) {
+    free(errors);
+    free(ts);
+    return 1;
+  }
+
+  for(size_t i = 0; i < threads; i++) {
+    ts[i].mode = mode;
+    ts[i].waits = waits;
+    ts[i].jump = jump;
+    ts[i].seed = (unsigned)i * 7919u + 1;
+    ts[i].errors = errors + i * waits;
+    if(pthread_create(&ts[i].thread, NULL, bench_thread, &ts[i]) != 0) {
+      fprintf(stderr, "pthread_create failed\n");
+      exit(1);
+    }
+  }
+  for(size_t i = 0; i < threads; i++) {
+    pthread_join(ts[i].thread, NULL);
+  }
+
+  qsort(errors, total, sizeof(int64_t), cmp_int64);
+
+  double sum = 0.0;
+  size_t early = 0;
+  for(size_t i = 0; i < total; i++) {
+    sum += (double)errors[i];
+    if(errors[i] < 0) { early++; }
+  }
+
+  printf("%-10s %9.1f %9lld %9lld %9lld %9lld %7zu\n", name,
+         sum / (double)total,
+         (long long)errors[total / 2],
+         (long long)errors[total * 99 / 100],
+         (long long)errors[total * 999 / 1000],
+         (long long)errors[total - 1],
+         early);
+
+  free(errors);
+  free(ts);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t threads = 4;
+  size_t waits = 500;
+  int64_t jump = 0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "t:n:j:")) != -1) {
+    switch(opt) {
+    case 't': threads = strtoul(optarg, NULL, 10); break;
+    case 'n': waits = strtoul(optarg, NULL, 10); break;
+    case 'j': jump = INT64_C(1000) * strtoll(optarg, NULL, 10); break;
+    default:
+      fprintf(stderr, "usage: %s [-t threads] [-n waits] [-j jump_ms]\n", argv[0]);
+      return 2;
+    }
+  }
+  if(threads == 0 || waits == 0) {
+    fprintf(stderr, "need at least one thread and one wait\n");
+    return 2;
+  }
+
+  printf("%zu threads x %zu waits of %d-%dms", threads, waits,
+         MIN_DELAY / 1000, MAX_DELAY / 1000);
+  if(jump != 0) {
+    printf(", realtime set back %lldms every 4th wait", (long long)(jump / 1000));
+  }
+  printf("\nwakeup error in microseconds:\n");
+  printf("%-10s %9s %9s %9s %9s %9s %7s\n", "", "mean", "p50", "p99", "p99.9", "max", "early");
+
+  int ret = run("monotonic", MODE_MONOTONIC, threads, waits, jump);
+  ret |= run("translated", MODE_TRANSLATED, threads, waits, jump);
+  return ret;
+}
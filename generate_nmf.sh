@@ -0,0 +1,47 @@
+#!/bin/sh
+
+# Writes a manifest for whatever has been built into the build dir ($1) under
+# the name $2 (`vlc` by default, `vlc-PROFILE` for `compile --profile`) to
+# stdout. The native nexes are listed per arch, and the pexe as the portable
+# fallback: Chrome runs the nexe matching its arch when it is allowed to run
+# native code at all (ie `application/x-nacl` in an app or extension), and
+# translates the pexe otherwise.
+
+BUILD_DIR=$1
+NAME=${2:-vlc}
+
+if [ -z "$BUILD_DIR" ]; then
+    echo "usage: $0 BUILD_DIR [NAME]" >&2
+    exit 1
+fi
+
+ENTRIES=
+
+add_entry()
+{
+    if [ -z "$ENTRIES" ]; then
+        ENTRIES="    $1"
+    else
+        ENTRIES="${ENTRIES},
+    $1"
+    fi
+}
+
+# ARCH:nmf key
+for arch in x86_64:x86-64 i686:x86-32 arm:arm; do
+    file="${NAME}-${arch%%:*}.nexe"
+    if [ -f "$BUILD_DIR/$file" ]; then
+        add_entry "\"${arch#*:}\": { \"url\": \"$file\" }"
+    fi
+done
+
+if [ -f "$BUILD_DIR/${NAME}.pexe" ]; then
+    add_entry "\"portable\": { \"pnacl-translate\": { \"url\": \"${NAME}.pexe\", \"optlevel\": 2 } }"
+fi
+
+if [ -z "$ENTRIES" ]; then
+    echo "$0: no ${NAME} has been built in $BUILD_DIR" >&2
+    exit 1
+fi
+
+printf '{\n  "program": {\n%s\n  }\n}\n' "$ENTRIES"
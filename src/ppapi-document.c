@@ -0,0 +1,266 @@
+/**
+ * @file ppapi-document.c
+ * @brief Access module reading from the URL loader handed to
+ * `PPP_Instance::HandleDocumentLoad`.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <config.h>
+
+#define MODULE_NAME ppapi_document
+#define MODULE_STRING "ppapi_document"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_access.h>
+#include <vlc_arrays.h>
+#include <vlc_ppapi.h>
+
+#include "ppapi.h"
+
+// When the plugin is the MIME handler for a top-level navigation, the browser
+// has already started the download and gives us its loader. Rather than
+// throwing it away and fetching the media again, bin/ppapi.c parks the loader
+// here and plays `ppapi-document://<instance>`, which this module then reads
+// from.
+
+typedef struct document_t {
+  PP_Instance instance;
+  PP_Resource loader;
+} document_t;
+
+static vlc_mutex_t g_documents_mtx = VLC_STATIC_MUTEX;
+static DECL_ARRAY(document_t) g_documents = { 0, 0, NULL };
+
+void vlc_ppapi_set_document_loader(PP_Instance instance, PP_Resource loader) {
+  assert(instance != 0);
+
+  vlc_mutex_lock(&g_documents_mtx);
+  for(size_t i = 0; i < (size_t)g_documents.i_size; i++) {
+    document_t* item = &ARRAY_VAL(g_documents, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    vlc_subResReference(item->loader);
+    item->loader = vlc_addResReference(loader);
+    vlc_mutex_unlock(&g_documents_mtx);
+    return;
+  }
+
+  document_t doc = {
+    instance,
+    vlc_addResReference(loader),
+  };
+  ARRAY_APPEND(g_documents, doc);
+  vlc_mutex_unlock(&g_documents_mtx);
+}
+
+PP_Resource vlc_ppapi_take_document_loader(PP_Instance instance) {
+  assert(instance != 0);
+
+  PP_Resource loader = 0;
+  vlc_mutex_lock(&g_documents_mtx);
+  for(size_t i = 0; i < (size_t)g_documents.i_size; i++) {
+    document_t item = ARRAY_VAL(g_documents, i);
+    if(item.instance != instance) {
+      continue;
+    }
+
+    ARRAY_REMOVE(g_documents, i);
+    loader = item.loader;
+    break;
+  }
+  vlc_mutex_unlock(&g_documents_mtx);
+  return loader;
+}
+
+static int  Open(vlc_object_t*);
+static void Close(vlc_object_t*);
+
+vlc_module_begin()
+  set_shortname(N_("PPAPI document"))
+  set_description(N_("PPAPI document load access"))
+  set_category(CAT_INPUT)
+  set_subcategory(SUBCAT_INPUT_ACCESS)
+  set_capability("access", 0)
+  add_shortcut("ppapi-document")
+  set_callbacks(Open, Close)
+vlc_module_end()
+
+struct access_sys_t {
+  PP_Instance instance;
+  PP_Resource loader;
+
+  char* content_type;
+
+  vlc_ppapi_stats_t* stats;
+};
+
+static ssize_t Read(access_t* access, uint8_t* buffer, size_t len);
+static int Control(access_t* access, int query, va_list args);
+
+// Pulls `Content-Type` out of the raw response headers, so demuxers which key
+// off the MIME type (ie playlists) get a hint.
+static char* get_content_type(PP_Resource loader) {
+  const vlc_ppapi_url_loader_t* iloader = vlc_getPPAPI_URLLoader();
+  const vlc_ppapi_url_response_info_t* iresponse = vlc_getPPAPI_URLResponseInfo();
+  const vlc_ppapi_var_t* ivar = vlc_getPPAPI_Var();
+
+  PP_Resource response = iloader->GetResponseInfo(loader);
+  if(response == 0) { return NULL; }
+
+  PP_Var headers_var = iresponse->GetProperty(response, PP_URLRESPONSEPROPERTY_HEADERS);
+  vlc_subResReference(response);
+
+  uint32_t len = 0;
+  const char* headers = ivar->VarToUtf8(headers_var, &len);
+  char* result = NULL;
+
+  static const char key[] = "content-type:";
+  for(uint32_t line = 0; headers != NULL && line < len;) {
+    uint32_t end = line;
+    while(end < len && headers[end] != '\n') { end++; }
+
+    if(end - line > sizeof(key) - 1 &&
+       strncasecmp(headers + line, key, sizeof(key) - 1) == 0) {
+      uint32_t start = line + sizeof(key) - 1;
+      while(start < end && headers[start] == ' ') { start++; }
+      uint32_t stop = end;
+      while(stop > start && (headers[stop - 1] == '\r' || headers[stop - 1] == ' ')) { stop--; }
+      result = strndup(headers + start, stop - start);
+      break;
+    }
+
+    line = end + 1;
+  }
+
+  vlc_ppapi_deref_var(headers_var);
+  return result;
+}
+
+static int Open(vlc_object_t* obj) {
+  access_t* access = (access_t*)obj;
+
+  char* end = NULL;
+  const long instance = strtol(access->psz_location, &end, 10);
+  if(end == access->psz_location || *end != '\0' || instance <= 0) {
+    msg_Err(access, "invalid document location `%s`", access->psz_location);
+    return VLC_EGENERIC;
+  }
+
+  const PP_Resource loader = vlc_ppapi_take_document_loader((PP_Instance)instance);
+  if(loader == 0) {
+    msg_Err(access, "no pending document load for instance `%ld`", instance);
+    return VLC_EGENERIC;
+  }
+
+  access_sys_t* sys = malloc(sizeof(access_sys_t));
+  if(unlikely(sys == NULL)) {
+    vlc_subResReference(loader);
+    return VLC_ENOMEM;
+  }
+
+  sys->instance = (PP_Instance)instance;
+  sys->loader = loader;
+  sys->content_type = get_content_type(loader);
+  sys->stats = vlc_ppapi_get_stats(sys->instance);
+
+  access->p_sys = sys;
+  ACCESS_SET_CALLBACKS(Read, NULL, Control, NULL);
+
+  msg_Dbg(access, "streaming the document load of instance `%ld` (%s)",
+          instance, sys->content_type != NULL ? sys->content_type : "unknown type");
+
+  return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t* obj) {
+  access_t* access = (access_t*)obj;
+  access_sys_t* sys = access->p_sys;
+
+  vlc_getPPAPI_URLLoader()->Close(sys->loader);
+  vlc_subResReference(sys->loader);
+  free(sys->content_type);
+  free(sys);
+}
+
+static ssize_t Read(access_t* access, uint8_t* buffer, size_t len) {
+  access_sys_t* sys = access->p_sys;
+
+  if(access->info.b_eof) { return 0; }
+
+  const int32_t max_len = len > INT32_MAX ? INT32_MAX : (int32_t)len;
+  const mtime_t span = vlc_ppapi_trace_begin(sys->stats);
+  const int32_t read = vlc_getPPAPI_URLLoader()->ReadResponseBody(sys->loader, buffer, max_len,
+                                                                   PP_BlockUntilComplete());
+  vlc_ppapi_trace_end(sys->stats, "document-read", span);
+  if(read == 0) {
+    access->info.b_eof = true;
+    return 0;
+  } else if(read < 0) {
+    msg_Err(access, "reading the document failed: `%d`", read);
+    access->info.b_eof = true;
+    return 0;
+  }
+
+  return read;
+}
+
+static int Control(access_t* access, int query, va_list args) {
+  access_sys_t* sys = access->p_sys;
+
+  switch(query) {
+  case ACCESS_CAN_SEEK:
+  case ACCESS_CAN_FASTSEEK:
+    // the browser's loader only ever streams forward.
+    *va_arg(args, bool*) = false;
+    break;
+  case ACCESS_CAN_PAUSE:
+    // pausing is just not reading for a while; the loader buffers meanwhile.
+    *va_arg(args, bool*) = true;
+    break;
+  case ACCESS_SET_PAUSE_STATE:
+    break;
+  case ACCESS_CAN_CONTROL_PACE:
+    *va_arg(args, bool*) = true;
+    break;
+  case ACCESS_GET_SIZE: {
+    int64_t received = 0, total = -1;
+    vlc_getPPAPI_URLLoader()->GetDownloadProgress(sys->loader, &received, &total);
+    if(total < 0) { return VLC_EGENERIC; }
+    *va_arg(args, uint64_t*) = (uint64_t)total;
+    break;
+  }
+  case ACCESS_GET_PTS_DELAY:
+    *va_arg(args, int64_t*) = INT64_C(1000) * var_InheritInteger(access, "network-caching");
+    break;
+  case ACCESS_GET_CONTENT_TYPE:
+    if(sys->content_type == NULL) { return VLC_EGENERIC; }
+    *va_arg(args, char**) = strdup(sys->content_type);
+    break;
+  default:
+    return VLC_EGENERIC;
+  }
+
+  return VLC_SUCCESS;
+}
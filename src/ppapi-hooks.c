@@ -0,0 +1,681 @@
+/**
+ * @file ppapi-hooks.c
+ * @brief Wraps the browser interfaces the vlc tree's modules are handed, so
+ * what they do with them can be measured without patching them.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_threads.h>
+#include <vlc_atomic.h>
+#include <vlc_ppapi.h>
+
+#include <ppapi/c/ppb_opengles2.h>
+#include <ppapi/c/ppp_message_handler.h>
+
+#include "ppapi.h"
+
+// Every module gets its interfaces from the getters in src/ppapi.c, so
+// handing them a copy of an interface with a few members swapped for the ones
+// below is enough to see every call. The wrappers forward to the browser's
+// interface and only then record what happened.
+
+// A completion callback of the module, run by our own once we've had a look at
+// the result.
+typedef struct pending_t {
+  PP_Resource resource;
+  // when the call was made.
+  mtime_t start;
+  struct PP_CompletionCallback callback;
+} pending_t;
+
+// Makes `call` with `callback` swapped for `hook`, which is then passed a
+// pending_t of `res` and `callback`, and calls `done` with the resource,
+// when the call was made and its result. The browser only runs the callback if
+// the call returned PP_OK_COMPLETIONPENDING, so otherwise `done` is called
+// right away. A blocking call is made as is; so is one we're out of memory
+// for, which then goes unrecorded.
+#define HOOK_COMPLETION(result, res, callback, hook, done, call)        \
+  do {                                                                  \
+    const mtime_t start_ = mdate();                                     \
+    pending_t* pending_ = NULL;                                         \
+    if((callback).func != NULL) {                                       \
+      pending_ = malloc(sizeof(pending_t));                             \
+    }                                                                   \
+    if(pending_ == NULL) {                                              \
+      (result) = call;                                                  \
+      if((callback).func == NULL) { done((res), start_, (result)); }    \
+      break;                                                            \
+    }                                                                   \
+    pending_->resource = (res);                                         \
+    pending_->start = start_;                                           \
+    pending_->callback = (callback);                                    \
+    (callback) = PP_MakeCompletionCallback((hook), pending_);           \
+    (callback).flags = pending_->callback.flags;                        \
+    (result) = call;                                                    \
+    if((result) != PP_OK_COMPLETIONPENDING) {                           \
+      free(pending_);                                                   \
+      done((res), start_, (result));                                    \
+    }                                                                   \
+  } while(0)
+
+// Defines `hook`, the completion callback HOOK_COMPLETION passes, which calls
+// `done` and then the module's callback.
+#define DEFINE_COMPLETION_HOOK(hook, done)                              \
+  static void hook(void* user_data, int32_t result) {                   \
+    pending_t* pending = user_data;                                     \
+    done(pending->resource, pending->start, result);                    \
+    PP_RunCompletionCallback(&pending->callback, result);               \
+    free(pending);                                                      \
+  }
+
+/* URLLoader */
+
+// One request of a module. Loaders the modules didn't create (ie the
+// document loader of a full-frame navigation) aren't tracked.
+typedef struct transfer_t {
+  PP_Resource loader;
+  PP_Instance instance;
+  // whether the instance wants `transfer` events.
+  bool events;
+
+  // when Open was called, and when it completed (ie the response headers
+  // arrived):
+  mtime_t opened;
+  mtime_t responded;
+
+  // the download progress the current bandwidth sample started at, and the
+  // last change of it we saw (see read_done):
+  int64_t sample_bytes;
+  mtime_t sample_start;
+  int64_t progress_bytes;
+  mtime_t progress_time;
+
+  // the module read to the end of the body.
+  bool complete;
+} transfer_t;
+
+// Progress is batched up to this before it's sampled; less is too little to
+// tell us anything about throughput.
+#define SAMPLE_BYTES (64 * 1024)
+// Going this long without any progress means the transfer stalled (ie the
+// loader's buffer is full while playback is paused), not that it's slow.
+#define SAMPLE_STALL (CLOCK_FREQ / 2)
+
+static const vlc_ppapi_url_loader_t* g_real_url_loader = NULL;
+static const vlc_ppapi_url_request_info_t* g_real_url_request_info = NULL;
+static vlc_ppapi_url_loader_t g_url_loader;
+
+static vlc_mutex_t g_transfers_mtx = VLC_STATIC_MUTEX;
+static DECL_ARRAY(transfer_t) g_transfers = { 0, 0, NULL };
+
+// Requires g_transfers_mtx.
+static transfer_t* find_transfer(PP_Resource loader, size_t* index) {
+  for(size_t i = 0; i < (size_t)g_transfers.i_size; i++) {
+    transfer_t* item = &ARRAY_VAL(g_transfers, i);
+    if(item->loader != loader) {
+      continue;
+    }
+
+    if(index != NULL) { *index = i; }
+    return item;
+  }
+  return NULL;
+}
+
+static void post_transfer(const transfer_t* transfer) {
+  VLC_PPAPI_STATIC_STR(bytes_key, "bytes");
+  VLC_PPAPI_STATIC_STR(ttfb_key, "ttfb");
+  VLC_PPAPI_STATIC_STR(duration_key, "duration");
+  VLC_PPAPI_STATIC_STR(bandwidth_key, "bandwidth");
+  VLC_PPAPI_STATIC_STR(complete_key, "complete");
+
+  // the response never came.
+  if(transfer->responded == 0) { return; }
+
+  const mtime_t last = transfer->progress_time != 0 ? transfer->progress_time : transfer->responded;
+  const double body = (double)(last - transfer->responded) / CLOCK_FREQ;
+  const double bandwidth = body > 0.0 ? (double)transfer->progress_bytes * 8.0 / body : 0.0;
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+  PP_Var value = idict->Create();
+  // seconds and bits per second, as doubles like the rest of the stats.
+  idict->Set(value, vlc_ppapi_mk_str(&bytes_key), PP_MakeDouble((double)transfer->progress_bytes));
+  idict->Set(value, vlc_ppapi_mk_str(&ttfb_key),
+             PP_MakeDouble((double)(transfer->responded - transfer->opened) / CLOCK_FREQ));
+  idict->Set(value, vlc_ppapi_mk_str(&duration_key),
+             PP_MakeDouble((double)(last - transfer->opened) / CLOCK_FREQ));
+  idict->Set(value, vlc_ppapi_mk_str(&bandwidth_key), PP_MakeDouble(bandwidth));
+  idict->Set(value, vlc_ppapi_mk_str(&complete_key), PP_MakeBool(PP_FromBool(transfer->complete)));
+
+  vlc_ppapi_post_input_event(transfer->instance, "transfer", value);
+  vlc_ppapi_deref_var(value);
+}
+
+static PP_Resource url_loader_create(PP_Instance instance) {
+  const PP_Resource loader = g_real_url_loader->Create(instance);
+  if(loader == 0) { return 0; }
+
+  const transfer_t transfer = {
+    .loader = loader,
+    .instance = instance,
+    .events = vlc_ppapi_input_events_enabled(instance),
+  };
+  vlc_mutex_lock(&g_transfers_mtx);
+  ARRAY_APPEND(g_transfers, transfer);
+  vlc_mutex_unlock(&g_transfers_mtx);
+
+  return loader;
+}
+
+static void open_done(PP_Resource loader, mtime_t start, int32_t result) {
+  if(result != PP_OK) { return; }
+
+  vlc_mutex_lock(&g_transfers_mtx);
+  transfer_t* transfer = find_transfer(loader, NULL);
+  if(transfer != NULL) {
+    transfer->opened = start;
+    transfer->responded = mdate();
+  }
+  vlc_mutex_unlock(&g_transfers_mtx);
+}
+
+DEFINE_COMPLETION_HOOK(open_completed, open_done)
+
+static int32_t url_loader_open(PP_Resource loader, PP_Resource request,
+                               struct PP_CompletionCallback callback) {
+  // without this the browser doesn't count what it received, and
+  // GetDownloadProgress fails.
+  g_real_url_request_info->SetProperty(request, PP_URLREQUESTPROPERTY_RECORDDOWNLOADPROGRESS,
+                                       PP_MakeBool(PP_TRUE));
+
+  int32_t result;
+  HOOK_COMPLETION(result, loader, callback, open_completed, open_done,
+                  g_real_url_loader->Open(loader, request, callback));
+  return result;
+}
+
+// Samples what the browser has received against wall-clock time. How long the
+// module's reads take says nothing about the network once playback is paced:
+// they are served from what the loader has already buffered.
+static void read_done(PP_Resource loader, mtime_t start, int32_t result) {
+  VLC_UNUSED(start);
+  if(result < 0) { return; }
+
+  int64_t received = 0, total = -1;
+  if(g_real_url_loader->GetDownloadProgress(loader, &received, &total) != PP_TRUE) {
+    return;
+  }
+  const mtime_t now = mdate();
+
+  PP_Instance instance = 0;
+  uint64_t sample_bytes = 0;
+  mtime_t sample_duration = 0;
+  transfer_t finished = { 0 };
+  bool post = false;
+
+  vlc_mutex_lock(&g_transfers_mtx);
+  transfer_t* transfer = find_transfer(loader, NULL);
+  if(transfer == NULL) {
+    vlc_mutex_unlock(&g_transfers_mtx);
+    return;
+  }
+
+  instance = transfer->instance;
+  if(received != transfer->progress_bytes) {
+    // what arrived before the first read, or during a stall, arrived at some
+    // unknown point since; start over from here.
+    if(transfer->sample_start == 0 || now - transfer->progress_time > SAMPLE_STALL) {
+      transfer->sample_bytes = received;
+      transfer->sample_start = now;
+    }
+    transfer->progress_bytes = received;
+    transfer->progress_time = now;
+  }
+  // the tail of the body is sampled too, however small: the estimator drops
+  // what's too small to mean anything.
+  if(transfer->sample_start != 0 &&
+     (received - transfer->sample_bytes >= SAMPLE_BYTES || (result == 0 && received > transfer->sample_bytes))) {
+    sample_bytes = (uint64_t)(received - transfer->sample_bytes);
+    sample_duration = transfer->progress_time - transfer->sample_start;
+    transfer->sample_bytes = received;
+    transfer->sample_start = transfer->progress_time;
+  }
+  if(result == 0 && !transfer->complete) {
+    transfer->complete = true;
+    post = transfer->events;
+    finished = *transfer;
+  }
+  vlc_mutex_unlock(&g_transfers_mtx);
+
+  if(sample_bytes != 0) {
+    vlc_ppapi_bandwidth_sample(instance, sample_bytes, sample_duration);
+  }
+  if(post) {
+    post_transfer(&finished);
+  }
+}
+
+DEFINE_COMPLETION_HOOK(read_completed, read_done)
+
+static int32_t url_loader_read_response_body(PP_Resource loader, void* buffer, int32_t bytes,
+                                             struct PP_CompletionCallback callback) {
+  int32_t result;
+  HOOK_COMPLETION(result, loader, callback, read_completed, read_done,
+                  g_real_url_loader->ReadResponseBody(loader, buffer, bytes, callback));
+  return result;
+}
+
+static void url_loader_close(PP_Resource loader) {
+  g_real_url_loader->Close(loader);
+
+  transfer_t closed = { 0 };
+  bool post = false;
+
+  vlc_mutex_lock(&g_transfers_mtx);
+  size_t index = 0;
+  transfer_t* transfer = find_transfer(loader, &index);
+  if(transfer != NULL) {
+    // a complete transfer was posted when its end was read.
+    post = transfer->events && !transfer->complete;
+    closed = *transfer;
+    ARRAY_REMOVE(g_transfers, index);
+  }
+  vlc_mutex_unlock(&g_transfers_mtx);
+
+  if(post) {
+    post_transfer(&closed);
+  }
+}
+
+const vlc_ppapi_url_loader_t* vlc_ppapi_hook_url_loader(const vlc_ppapi_url_loader_t* loader,
+                                                        const vlc_ppapi_url_request_info_t* request_info) {
+  assert(loader != NULL && request_info != NULL);
+
+  g_real_url_loader = loader;
+  g_real_url_request_info = request_info;
+
+  g_url_loader = *loader;
+  g_url_loader.Create = url_loader_create;
+  g_url_loader.Open = url_loader_open;
+  g_url_loader.ReadResponseBody = url_loader_read_response_body;
+  g_url_loader.Close = url_loader_close;
+  return &g_url_loader;
+}
+
+/* Messaging */
+
+// ppapi_control's message handler; ours forwards to it.
+typedef struct message_handler_t {
+  const struct PPP_MessageHandler_0_2* handler;
+  void* user_data;
+  vlc_ppapi_stats_t* stats;
+} message_handler_t;
+
+static const vlc_ppapi_messaging_t* g_real_messaging = NULL;
+static vlc_ppapi_messaging_t g_messaging;
+
+static void handle_message(PP_Instance instance, void* user_data,
+                           const struct PP_Var* message) {
+  message_handler_t* mh = user_data;
+  vlc_ppapi_stats_add(mh->stats, VLC_PPAPI_STATS_MESSAGES, 1);
+  const mtime_t span = vlc_ppapi_trace_begin(mh->stats);
+  mh->handler->HandleMessage(instance, mh->user_data, message);
+  vlc_ppapi_trace_end(mh->stats, "message-dispatch", span);
+}
+
+static void handle_blocking_message(PP_Instance instance, void* user_data,
+                                    const struct PP_Var* message, struct PP_Var* response) {
+  message_handler_t* mh = user_data;
+  vlc_ppapi_stats_add(mh->stats, VLC_PPAPI_STATS_MESSAGES, 1);
+  const mtime_t span = vlc_ppapi_trace_begin(mh->stats);
+  mh->handler->HandleBlockingMessage(instance, mh->user_data, message, response);
+  vlc_ppapi_trace_end(mh->stats, "message-dispatch-blocking", span);
+}
+
+static void destroy_message_handler(PP_Instance instance, void* user_data) {
+  message_handler_t* mh = user_data;
+  mh->handler->Destroy(instance, mh->user_data);
+  free(mh);
+}
+
+static const struct PPP_MessageHandler_0_2 g_message_handler = {
+  handle_message,
+  handle_blocking_message,
+  destroy_message_handler,
+};
+
+static int32_t messaging_register_message_handler(PP_Instance instance, void* user_data,
+                                                  const struct PPP_MessageHandler_0_2* handler,
+                                                  PP_Resource message_loop) {
+  message_handler_t* mh = malloc(sizeof(message_handler_t));
+  if(unlikely(mh == NULL)) {
+    return g_real_messaging->RegisterMessageHandler(instance, user_data, handler, message_loop);
+  }
+  mh->handler = handler;
+  mh->user_data = user_data;
+  mh->stats = vlc_ppapi_get_stats(instance);
+
+  const int32_t result = g_real_messaging->RegisterMessageHandler(instance, mh, &g_message_handler,
+                                                                  message_loop);
+  if(result != PP_OK) {
+    free(mh);
+  }
+  return result;
+}
+
+const vlc_ppapi_messaging_t* vlc_ppapi_hook_messaging(const vlc_ppapi_messaging_t* messaging) {
+  assert(messaging != NULL);
+
+  g_real_messaging = messaging;
+  g_messaging = *messaging;
+  g_messaging.RegisterMessageHandler = messaging_register_message_handler;
+  return &g_messaging;
+}
+
+/* Audio */
+
+// One stream of an audio output. It's our callback's user data, so the audio
+// thread never has to look it up.
+typedef struct audio_t {
+  PP_Resource audio;
+  PP_Instance instance;
+  vlc_ppapi_stats_t* stats;
+
+  PPB_Audio_Callback callback;
+  void* user_data;
+
+  // how long the samples of one callback last,
+  mtime_t period;
+  // and when the last callback started; 0 until playback (re)starts.
+  atomic_int_least64_t last;
+} audio_t;
+
+// The browser asks for the next buffer as the previous one runs out, so a
+// callback starting this much later than the last one lasted means the output
+// most likely ran dry in between.
+#define AUDIO_UNDERRUN(period) ((period) * 3 / 2)
+
+static const vlc_ppapi_audio_t* g_real_audio = NULL;
+static const vlc_ppapi_audio_config_t* g_real_audio_config = NULL;
+static vlc_ppapi_audio_t g_audio;
+
+static vlc_mutex_t g_audios_mtx = VLC_STATIC_MUTEX;
+static DECL_ARRAY(audio_t*) g_audios = { 0, 0, NULL };
+
+// Frees the streams whose resource is gone: the browser stops a stream's
+// thread before releasing it, so their callbacks can't run anymore. Requires
+// g_audios_mtx.
+static void prune_audios(void) {
+  for(size_t i = 0; i < (size_t)g_audios.i_size;) {
+    audio_t* audio = ARRAY_VAL(g_audios, i);
+    if(g_real_audio->IsAudio(audio->audio) == PP_TRUE) {
+      i++;
+      continue;
+    }
+
+    ARRAY_REMOVE(g_audios, i);
+    free(audio);
+  }
+}
+
+static void audio_callback(void* sample_buffer, uint32_t buffer_size_in_bytes,
+                           PP_TimeDelta latency, void* user_data) {
+  audio_t* audio = user_data;
+
+  const mtime_t now = mdate();
+  const mtime_t last = atomic_exchange_explicit(&audio->last, now, memory_order_relaxed);
+  if(last != 0 && audio->period != 0 && now - last > AUDIO_UNDERRUN(audio->period)) {
+    vlc_ppapi_stats_add(audio->stats, VLC_PPAPI_STATS_AUDIO_UNDERRUNS, 1);
+  }
+
+  const mtime_t span = vlc_ppapi_trace_begin(audio->stats);
+  audio->callback(sample_buffer, buffer_size_in_bytes, latency, audio->user_data);
+  vlc_ppapi_trace_end(audio->stats, "audio-callback", span);
+}
+
+static PP_Resource audio_create(PP_Instance instance, PP_Resource config,
+                                PPB_Audio_Callback callback, void* user_data) {
+  audio_t* audio = malloc(sizeof(audio_t));
+  if(unlikely(audio == NULL)) {
+    return g_real_audio->Create(instance, config, callback, user_data);
+  }
+
+  const uint32_t rate = (uint32_t)g_real_audio_config->GetSampleRate(config);
+  const uint32_t frames = g_real_audio_config->GetSampleFrameCount(config);
+
+  audio->instance = instance;
+  audio->stats = vlc_ppapi_get_stats(instance);
+  audio->callback = callback;
+  audio->user_data = user_data;
+  audio->period = rate != 0 ? (mtime_t)frames * CLOCK_FREQ / rate : 0;
+  atomic_init(&audio->last, 0);
+
+  // the thread only starts with StartPlayback, ie once this has returned.
+  audio->audio = g_real_audio->Create(instance, config, audio_callback, audio);
+  if(audio->audio == 0) {
+    free(audio);
+    return 0;
+  }
+
+  vlc_mutex_lock(&g_audios_mtx);
+  prune_audios();
+  ARRAY_APPEND(g_audios, audio);
+  vlc_mutex_unlock(&g_audios_mtx);
+
+  return audio->audio;
+}
+
+static PP_Bool audio_start_playback(PP_Resource resource) {
+  // the gap while stopped isn't an underrun.
+  vlc_mutex_lock(&g_audios_mtx);
+  for(size_t i = 0; i < (size_t)g_audios.i_size; i++) {
+    audio_t* audio = ARRAY_VAL(g_audios, i);
+    if(audio->audio != resource) {
+      continue;
+    }
+
+    atomic_store_explicit(&audio->last, 0, memory_order_relaxed);
+    break;
+  }
+  vlc_mutex_unlock(&g_audios_mtx);
+
+  return g_real_audio->StartPlayback(resource);
+}
+
+const vlc_ppapi_audio_t* vlc_ppapi_hook_audio(const vlc_ppapi_audio_t* audio,
+                                              const vlc_ppapi_audio_config_t* audio_config) {
+  assert(audio != NULL && audio_config != NULL);
+
+  g_real_audio = audio;
+  g_real_audio_config = audio_config;
+
+  g_audio = *audio;
+  g_audio.Create = audio_create;
+  g_audio.StartPlayback = audio_start_playback;
+  return &g_audio;
+}
+
+/* Graphics3D and OpenGLES2 */
+
+typedef struct context_t {
+  PP_Resource context;
+  PP_Instance instance;
+  vlc_ppapi_stats_t* stats;
+} context_t;
+
+// A swap completes once the compositor has taken the frame, normally by the
+// next vsync; taking longer than two of them (at 60Hz) means the frame was
+// shown late.
+#define SWAP_LATE (CLOCK_FREQ / 30)
+
+static const vlc_ppapi_graphics_3d_t* g_real_graphics_3d = NULL;
+static vlc_ppapi_graphics_3d_t g_graphics_3d;
+static const struct PPB_OpenGLES2* g_real_opengles2 = NULL;
+static struct PPB_OpenGLES2 g_opengles2;
+
+static vlc_mutex_t g_contexts_mtx = VLC_STATIC_MUTEX;
+static DECL_ARRAY(context_t) g_contexts = { 0, 0, NULL };
+
+static vlc_ppapi_stats_t* context_stats(PP_Resource context) {
+  vlc_ppapi_stats_t* result = NULL;
+  vlc_mutex_lock(&g_contexts_mtx);
+  for(size_t i = 0; i < (size_t)g_contexts.i_size; i++) {
+    context_t* item = &ARRAY_VAL(g_contexts, i);
+    if(item->context != context) {
+      continue;
+    }
+
+    result = item->stats;
+    break;
+  }
+  vlc_mutex_unlock(&g_contexts_mtx);
+  return result;
+}
+
+static PP_Resource graphics_3d_create(PP_Instance instance, PP_Resource share_context,
+                                      const int32_t attrib_list[]) {
+  const PP_Resource context = g_real_graphics_3d->Create(instance, share_context, attrib_list);
+  if(context == 0) { return 0; }
+
+  const context_t item = {
+    context,
+    instance,
+    vlc_ppapi_get_stats(instance),
+  };
+  vlc_mutex_lock(&g_contexts_mtx);
+  // drop the contexts that are gone.
+  for(size_t i = 0; i < (size_t)g_contexts.i_size;) {
+    if(g_real_graphics_3d->IsGraphics3D(ARRAY_VAL(g_contexts, i).context) == PP_TRUE) {
+      i++;
+    } else {
+      ARRAY_REMOVE(g_contexts, i);
+    }
+  }
+  ARRAY_APPEND(g_contexts, item);
+  vlc_mutex_unlock(&g_contexts_mtx);
+
+  return context;
+}
+
+static void swap_done(PP_Resource context, mtime_t start, int32_t result) {
+  if(result != PP_OK) { return; }
+
+  vlc_ppapi_stats_t* stats = context_stats(context);
+  if(stats == NULL) { return; }
+
+  if(mdate() - start > SWAP_LATE) {
+    vlc_ppapi_stats_add(stats, VLC_PPAPI_STATS_FRAMES_LATE, 1);
+  }
+  // the span is from the call to the completion; this is a no-op when not
+  // tracing.
+  vlc_ppapi_trace_end(stats, "vout-swap", start);
+}
+
+DEFINE_COMPLETION_HOOK(swap_completed, swap_done)
+
+static int32_t graphics_3d_swap_buffers(PP_Resource context, struct PP_CompletionCallback callback) {
+  int32_t result;
+  HOOK_COMPLETION(result, context, callback, swap_completed, swap_done,
+                  g_real_graphics_3d->SwapBuffers(context, callback));
+  return result;
+}
+
+// Texture uploads are where the video output copies each picture into the
+// command buffer.
+static void opengles2_tex_image_2d(PP_Resource context, GLenum target, GLint level,
+                                   GLint internalformat, GLsizei width, GLsizei height,
+                                   GLint border, GLenum format, GLenum type, const void* pixels) {
+  vlc_ppapi_stats_t* stats = context_stats(context);
+  const mtime_t span = vlc_ppapi_trace_begin(stats);
+  g_real_opengles2->TexImage2D(context, target, level, internalformat, width, height,
+                               border, format, type, pixels);
+  vlc_ppapi_trace_end(stats, "vout-upload", span);
+}
+
+static void opengles2_tex_sub_image_2d(PP_Resource context, GLenum target, GLint level,
+                                       GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                                       GLenum format, GLenum type, const void* pixels) {
+  vlc_ppapi_stats_t* stats = context_stats(context);
+  const mtime_t span = vlc_ppapi_trace_begin(stats);
+  g_real_opengles2->TexSubImage2D(context, target, level, xoffset, yoffset, width, height,
+                                  format, type, pixels);
+  vlc_ppapi_trace_end(stats, "vout-upload", span);
+}
+
+const vlc_ppapi_graphics_3d_t* vlc_ppapi_hook_graphics_3d(const vlc_ppapi_graphics_3d_t* graphics_3d) {
+  assert(graphics_3d != NULL);
+
+  g_real_graphics_3d = graphics_3d;
+  g_graphics_3d = *graphics_3d;
+  g_graphics_3d.Create = graphics_3d_create;
+  g_graphics_3d.SwapBuffers = graphics_3d_swap_buffers;
+  return &g_graphics_3d;
+}
+
+const struct PPB_OpenGLES2* vlc_ppapi_hook_opengles2(const struct PPB_OpenGLES2* opengles2) {
+  assert(opengles2 != NULL);
+
+  g_real_opengles2 = opengles2;
+  g_opengles2 = *opengles2;
+  g_opengles2.TexImage2D = opengles2_tex_image_2d;
+  g_opengles2.TexSubImage2D = opengles2_tex_sub_image_2d;
+  return &g_opengles2;
+}
+
+void vlc_ppapi_hooks_forget_instance(PP_Instance instance) {
+  assert(instance != 0);
+
+  vlc_mutex_lock(&g_transfers_mtx);
+  for(size_t i = 0; i < (size_t)g_transfers.i_size;) {
+    if(ARRAY_VAL(g_transfers, i).instance == instance) {
+      ARRAY_REMOVE(g_transfers, i);
+    } else {
+      i++;
+    }
+  }
+  vlc_mutex_unlock(&g_transfers_mtx);
+
+  // by now the instance's modules are closed, and their streams with them.
+  vlc_mutex_lock(&g_audios_mtx);
+  for(size_t i = 0; i < (size_t)g_audios.i_size;) {
+    audio_t* audio = ARRAY_VAL(g_audios, i);
+    if(audio->instance == instance) {
+      ARRAY_REMOVE(g_audios, i);
+      free(audio);
+    } else {
+      i++;
+    }
+  }
+  vlc_mutex_unlock(&g_audios_mtx);
+
+  vlc_mutex_lock(&g_contexts_mtx);
+  for(size_t i = 0; i < (size_t)g_contexts.i_size;) {
+    if(ARRAY_VAL(g_contexts, i).instance == instance) {
+      ARRAY_REMOVE(g_contexts, i);
+    } else {
+      i++;
+    }
+  }
+  vlc_mutex_unlock(&g_contexts_mtx);
+}
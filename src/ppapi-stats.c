@@ -0,0 +1,254 @@
+/**
+ * @file ppapi-stats.c
+ * @brief Per-instance performance counters and the trace-event recorder.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_ppapi.h>
+
+#include "ppapi.h"
+
+// One recorded span. `seq` is the index the span was recorded at, plus one; it
+// is zeroed while the slot is being (re)written, so the exporter can skip
+// slots that are torn.
+typedef struct trace_event_t {
+  atomic_uint_least64_t seq;
+  const char* name;
+  mtime_t start;
+  mtime_t duration;
+  unsigned tid;
+} trace_event_t;
+
+struct vlc_ppapi_stats_t {
+  PP_Instance instance;
+
+  atomic_int_least64_t values[VLC_PPAPI_STATS_COUNT];
+
+  // tracing is off until vlc_ppapi_trace_enable is called; the ring is never
+  // resized after that.
+  atomic_uintptr_t trace;
+  size_t trace_capacity;
+  atomic_uint_least64_t trace_next;
+};
+
+static const char* const g_stat_names[VLC_PPAPI_STATS_COUNT] = {
+  [VLC_PPAPI_STATS_LOG_DROPPED] = "log_dropped",
+  [VLC_PPAPI_STATS_MESSAGES] = "messages",
+  [VLC_PPAPI_STATS_AUDIO_UNDERRUNS] = "audio_underruns",
+  [VLC_PPAPI_STATS_FRAMES_LATE] = "frames_late",
+  [VLC_PPAPI_STATS_CACHE_FILL] = "cache_fill",
+};
+
+vlc_ppapi_stats_t* vlc_ppapi_stats_new(PP_Instance instance) {
+  vlc_ppapi_stats_t* stats = malloc(sizeof(vlc_ppapi_stats_t));
+  if(unlikely(stats == NULL)) { return NULL; }
+
+  stats->instance = instance;
+  for(size_t i = 0; i < VLC_PPAPI_STATS_COUNT; i++) {
+    atomic_init(&stats->values[i], 0);
+  }
+  atomic_init(&stats->trace, 0);
+  stats->trace_capacity = 0;
+  atomic_init(&stats->trace_next, 0);
+
+  return stats;
+}
+
+void vlc_ppapi_stats_delete(vlc_ppapi_stats_t* stats) {
+  if(stats == NULL) { return; }
+  free((trace_event_t*)atomic_load(&stats->trace));
+  free(stats);
+}
+
+PP_Instance vlc_ppapi_stats_instance(const vlc_ppapi_stats_t* stats) {
+  assert(stats != NULL);
+  return stats->instance;
+}
+
+void vlc_ppapi_stats_add(vlc_ppapi_stats_t* stats, vlc_ppapi_stat_t stat, int64_t delta) {
+  if(stats == NULL) { return; }
+  assert(stat < VLC_PPAPI_STATS_COUNT);
+  atomic_fetch_add_explicit(&stats->values[stat], delta, memory_order_relaxed);
+}
+
+void vlc_ppapi_stats_set(vlc_ppapi_stats_t* stats, vlc_ppapi_stat_t stat, int64_t value) {
+  if(stats == NULL) { return; }
+  assert(stat < VLC_PPAPI_STATS_COUNT);
+  atomic_store_explicit(&stats->values[stat], value, memory_order_relaxed);
+}
+
+PP_Var vlc_ppapi_stats_to_var(vlc_ppapi_stats_t* stats) {
+  VLC_PPAPI_STATIC_STR(tracing_key, "tracing");
+
+  if(stats == NULL) { return PP_MakeUndefined(); }
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+  PP_Var result = idict->Create();
+
+  for(size_t i = 0; i < VLC_PPAPI_STATS_COUNT; i++) {
+    const int64_t value = atomic_load_explicit(&stats->values[i], memory_order_relaxed);
+    PP_Var key = vlc_ppapi_cstr_to_var(g_stat_names[i], strlen(g_stat_names[i]));
+    idict->Set(result, key, PP_MakeDouble((double)value));
+    vlc_ppapi_deref_var(key);
+  }
+
+  const bool tracing = atomic_load(&stats->trace) != 0;
+  idict->Set(result, vlc_ppapi_mk_str(&tracing_key), PP_MakeBool(PP_FromBool(tracing)));
+
+  return result;
+}
+
+// Small, stable thread ids for the trace viewer.
+static atomic_uint g_next_tid = ATOMIC_VAR_INIT(1);
+static _Thread_local unsigned t_tid = 0;
+
+static unsigned current_tid(void) {
+  if(t_tid == 0) {
+    t_tid = atomic_fetch_add(&g_next_tid, 1);
+  }
+  return t_tid;
+}
+
+int vlc_ppapi_trace_enable(vlc_ppapi_stats_t* stats, size_t capacity) {
+  assert(stats != NULL);
+  if(capacity == 0 || atomic_load(&stats->trace) != 0) { return VLC_EGENERIC; }
+
+  trace_event_t* ring = calloc(capacity, sizeof(trace_event_t));
+  if(unlikely(ring == NULL)) { return VLC_ENOMEM; }
+  for(size_t i = 0; i < capacity; i++) {
+    atomic_init(&ring[i].seq, 0);
+  }
+
+  stats->trace_capacity = capacity;
+  atomic_store(&stats->trace, (uintptr_t)ring);
+  return VLC_SUCCESS;
+}
+
+mtime_t vlc_ppapi_trace_begin(vlc_ppapi_stats_t* stats) {
+  if(stats == NULL || atomic_load_explicit(&stats->trace, memory_order_relaxed) == 0) {
+    return 0;
+  }
+  return mdate();
+}
+
+void vlc_ppapi_trace_end(vlc_ppapi_stats_t* stats, const char* name, mtime_t start) {
+  if(start == 0) { return; }
+  assert(stats != NULL && name != NULL);
+
+  trace_event_t* ring = (trace_event_t*)atomic_load_explicit(&stats->trace, memory_order_acquire);
+  if(ring == NULL) { return; }
+
+  const mtime_t now = mdate();
+  const uint64_t idx = atomic_fetch_add_explicit(&stats->trace_next, 1, memory_order_relaxed);
+  trace_event_t* event = &ring[idx % stats->trace_capacity];
+
+  atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  event->name = name;
+  event->start = start;
+  event->duration = now - start;
+  event->tid = current_tid();
+  atomic_store_explicit(&event->seq, idx + 1, memory_order_release);
+}
+
+// Builds the Chrome trace-event JSON (as loaded by about:tracing) of what's in
+// the ring. Span names are expected to be string literals, so they aren't
+// escaped.
+static char* trace_to_json(vlc_ppapi_stats_t* stats, size_t* out_len) {
+  trace_event_t* ring = (trace_event_t*)atomic_load_explicit(&stats->trace, memory_order_acquire);
+  if(ring == NULL) { return NULL; }
+
+  const uint64_t next = atomic_load(&stats->trace_next);
+  const uint64_t first = next > stats->trace_capacity ? next - stats->trace_capacity : 0;
+
+  static const char header[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  static const char footer[] = "]}";
+  // generous per event; names are short literals.
+  const size_t per_event = 192;
+  const size_t capacity = sizeof(header) + sizeof(footer) + (size_t)(next - first) * per_event;
+
+  char* buffer = malloc(capacity);
+  if(unlikely(buffer == NULL)) { return NULL; }
+
+  size_t len = sizeof(header) - 1;
+  memcpy(buffer, header, len);
+
+  bool first_event = true;
+  for(uint64_t idx = first; idx < next; idx++) {
+    trace_event_t* event = &ring[idx % stats->trace_capacity];
+    if(atomic_load_explicit(&event->seq, memory_order_acquire) != idx + 1) { continue; }
+
+    const char* name = event->name;
+    const mtime_t start = event->start;
+    const mtime_t duration = event->duration;
+    const unsigned tid = event->tid;
+
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&event->seq, memory_order_relaxed) != idx + 1) { continue; }
+    if(strlen(name) > per_event / 4) { continue; }
+
+    // always leave room for the footer.
+    const size_t room = capacity - len - sizeof(footer);
+    const int written = snprintf(buffer + len, room,
+                                 "%s{\"name\":\"%s\",\"cat\":\"vlc\",\"ph\":\"X\","
+                                 "\"ts\":%"PRId64",\"dur\":%"PRId64",\"pid\":%"PRId32",\"tid\":%u}",
+                                 first_event ? "" : ",", name, start, duration,
+                                 stats->instance, tid);
+    if(written < 0 || (size_t)written >= room) { break; }
+    len += (size_t)written;
+    first_event = false;
+  }
+
+  memcpy(buffer + len, footer, sizeof(footer));
+  len += sizeof(footer) - 1;
+
+  *out_len = len;
+  return buffer;
+}
+
+int vlc_ppapi_trace_post(vlc_ppapi_stats_t* stats) {
+  VLC_PPAPI_STATIC_STR(type_key, "type");
+  VLC_PPAPI_STATIC_STR(type_trace, "trace");
+  VLC_PPAPI_STATIC_STR(trace_key, "trace");
+
+  assert(stats != NULL);
+
+  size_t len = 0;
+  char* json = trace_to_json(stats, &len);
+  if(json == NULL) { return VLC_EGENERIC; }
+
+  PP_Var trace = vlc_ppapi_cstr_to_var(json, len);
+  free(json);
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+  PP_Var msg = idict->Create();
+  idict->Set(msg, vlc_ppapi_mk_str(&type_key), vlc_ppapi_mk_str(&type_trace));
+  idict->Set(msg, vlc_ppapi_mk_str(&trace_key), trace);
+
+  vlc_getPPAPI_Messaging()->PostMessage(stats->instance, msg);
+
+  vlc_ppapi_deref_var(trace);
+  vlc_ppapi_deref_var(msg);
+  return VLC_SUCCESS;
+}
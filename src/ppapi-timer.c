@@ -0,0 +1,413 @@
+/**
+ * @file ppapi-timer.c
+ * @brief Timed waits that stay on the monotonic clock.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// NaCl's IRT can't wait on a condition variable against anything but the
+// realtime clock, so an absolute monotonic deadline has to be translated to
+// realtime first, and any adjustment of the system clock while waiting makes
+// us oversleep (clock set back) or wake up early (clock set forward).
+//
+// Waking up early is easy to detect: the wait is just redone. Oversleeping
+// isn't, as nothing runs to notice. So every timed wait also queues its
+// deadline, plus BACKSTOP_GRACE, in a heap, and a few timer threads sleep
+// (relatively, so immune to clock steps) towards the earliest, then wake the
+// waiters still waiting. Normally the translated wait times out first and the
+// timer threads have nothing to do; the waiter is woken directly, with no
+// extra hop.
+//
+// Nothing polls: a timer thread only wakes up for a deadline, or after
+// SLEEP_HORIZON, so the ones left sleeping towards a waiter that has since
+// returned come back soon. A deadline earlier than any a timer thread sleeps
+// towards is handed to an idle one (started on demand, up to MAX_SLEEPERS).
+// Should every one be busy, the wait goes without a backstop.
+//
+// A timer thread never blocks on a waiter's mutex: it only tries to lock it,
+// and if that fails, it signals anyway and tries again a little later, until
+// the waiter is seen to be woken up. So a mutex held for long, or held across
+// a timed wait of its own, doesn't hold up any other waiter.
+//
+// bin/ppapi.c links this in place of libvlccore's vlc_cond_timedwait() and
+// mwait(), which `compile` renames to vlc_cond_timedwait__posix() (the
+// translated wait used here) and mwait__posix(). Built with PPAPI_TIMER_POSIX,
+// it only depends on POSIX instead, so extras/timedwait-bench.c can build it on
+// the host.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef PPAPI_TIMER_POSIX
+
+#include "ppapi-timer.h"
+
+typedef pthread_cond_t timer_cond_t;
+typedef pthread_mutex_t timer_mutex_t;
+
+#define timer_cond_wait pthread_cond_wait
+#define timer_cond_broadcast pthread_cond_broadcast
+#define timer_mutex_trylock pthread_mutex_trylock
+#define timer_mutex_unlock pthread_mutex_unlock
+#define timer_cleanup_push pthread_cleanup_push
+#define timer_cleanup_pop() pthread_cleanup_pop(0)
+#define timer_now vlc_ppapi_mdate
+
+int64_t vlc_ppapi_mdate(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+}
+
+__thread int64_t vlc_ppapi_realtime_skew = 0;
+
+// What vlc does without clock selection.
+static int translated_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, int64_t deadline) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t rt = (int64_t)now.tv_sec * INT64_C(1000000) + now.tv_nsec / 1000;
+  rt += deadline - vlc_ppapi_mdate() + vlc_ppapi_realtime_skew;
+  vlc_ppapi_realtime_skew = 0;
+
+  const struct timespec ts = {
+    .tv_sec = rt / INT64_C(1000000),
+    .tv_nsec = (long)(rt % INT64_C(1000000)) * 1000,
+  };
+  return pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+#else
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+
+typedef vlc_cond_t timer_cond_t;
+typedef vlc_mutex_t timer_mutex_t;
+
+// vlc's own, so cancellation works as it does everywhere else.
+#define timer_cond_wait vlc_cond_wait
+#define timer_cond_broadcast vlc_cond_broadcast
+#define timer_mutex_trylock vlc_mutex_trylock
+#define timer_mutex_unlock vlc_mutex_unlock
+#define timer_cleanup_push vlc_cleanup_push
+#define timer_cleanup_pop vlc_cleanup_pop
+#define timer_now mdate
+
+// libvlccore's original, renamed by `compile`.
+int vlc_cond_timedwait__posix(vlc_cond_t* cond, vlc_mutex_t* mutex, mtime_t deadline);
+#define translated_timedwait vlc_cond_timedwait__posix
+
+#endif
+
+#define MAX_SLEEPERS 8
+// microseconds:
+#define BACKSTOP_GRACE INT64_C(2000)
+#define SLEEP_HORIZON INT64_C(250000)
+// Retry interval for waiters whose mutex was busy, doubling up to the max.
+#define RETRY_MIN INT64_C(100)
+#define RETRY_MAX INT64_C(10000)
+
+typedef enum waiter_state_t {
+  WAITER_QUEUED, // in the heap
+  WAITER_FIRING, // popped; a timer thread is signaling it
+  WAITER_DONE,
+} waiter_state_t;
+
+typedef struct waiter_t {
+  timer_cond_t* cond;
+  timer_mutex_t* mutex;
+
+  // guarded by g_lock:
+  int64_t wake_at; // the backstop, then the next retry
+  int64_t retry;
+  waiter_state_t state;
+  size_t index;
+} waiter_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+// signaled for idle timer threads when there's a deadline nobody sleeps towards.
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+// signaled when a waiter leaves WAITER_FIRING.
+static pthread_cond_t g_fired = PTHREAD_COND_INITIALIZER;
+static waiter_t** g_heap = NULL;
+static size_t g_heap_count = 0;
+static size_t g_heap_capacity = 0;
+// when each timer thread will look at the heap next; INT64_MAX when it isn't
+// sleeping.
+static int64_t g_sleeping_until[MAX_SLEEPERS];
+static size_t g_threads = 0;
+static size_t g_idle = 0;
+
+static void sleep_for(int64_t us) {
+  struct timespec ts = {
+    .tv_sec = us / INT64_C(1000000),
+    .tv_nsec = (long)(us % INT64_C(1000000)) * 1000,
+  };
+  while(nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+/* min-heap on wake_at, g_lock held */
+
+static void heap_swap(size_t a, size_t b) {
+  waiter_t* tmp = g_heap[a];
+  g_heap[a] = g_heap[b];
+  g_heap[b] = tmp;
+  g_heap[a]->index = a;
+  g_heap[b]->index = b;
+}
+
+static void heap_up(size_t i) {
+  while(i != 0) {
+    const size_t parent = (i - 1) / 2;
+    if(g_heap[parent]->wake_at <= g_heap[i]->wake_at) { break; }
+    heap_swap(i, parent);
+    i = parent;
+  }
+}
+
+static void heap_down(size_t i) {
+  for(;;) {
+    const size_t left = 2 * i + 1, right = left + 1;
+    size_t smallest = i;
+    if(left < g_heap_count && g_heap[left]->wake_at < g_heap[smallest]->wake_at) {
+      smallest = left;
+    }
+    if(right < g_heap_count && g_heap[right]->wake_at < g_heap[smallest]->wake_at) {
+      smallest = right;
+    }
+    if(smallest == i) { break; }
+    heap_swap(i, smallest);
+    i = smallest;
+  }
+}
+
+static int heap_push(waiter_t* waiter) {
+  if(g_heap_count == g_heap_capacity) {
+    const size_t capacity = g_heap_capacity != 0 ? g_heap_capacity * 2 : 16;
+    waiter_t** heap = realloc(g_heap, capacity * sizeof(waiter_t*));
+    if(heap == NULL) { return ENOMEM; }
+    g_heap = heap;
+    g_heap_capacity = capacity;
+  }
+
+  waiter->index = g_heap_count;
+  g_heap[g_heap_count++] = waiter;
+  heap_up(waiter->index);
+  return 0;
+}
+
+static void heap_remove(waiter_t* waiter) {
+  const size_t i = waiter->index;
+  assert(i < g_heap_count && g_heap[i] == waiter);
+
+  g_heap_count--;
+  if(i != g_heap_count) {
+    g_heap[i] = g_heap[g_heap_count];
+    g_heap[i]->index = i;
+    heap_down(i);
+    heap_up(i);
+  }
+}
+
+// g_lock held. Whether some timer thread will look at the heap by `when`.
+static bool covered(int64_t when) {
+  for(size_t i = 0; i < g_threads; i++) {
+    if(g_sleeping_until[i] <= when) { return true; }
+  }
+  return false;
+}
+
+// g_lock held; dropped while signaling.
+static void fire_expired(void) {
+  while(g_heap_count != 0 && g_heap[0]->wake_at <= timer_now()) {
+    waiter_t* waiter = g_heap[0];
+    heap_remove(waiter);
+    waiter->state = WAITER_FIRING;
+    pthread_mutex_unlock(&g_lock);
+
+    // Holding the mutex means the waiter is blocked in its wait (it holds the
+    // mutex from the moment it queues until then, and can't leave while
+    // FIRING), so the signal can't be lost. Otherwise it might not be waiting
+    // yet: signal anyway, and retry until it's seen to be woken up.
+    const bool locked = timer_mutex_trylock(waiter->mutex) == 0;
+    timer_cond_broadcast(waiter->cond);
+    if(locked) {
+      timer_mutex_unlock(waiter->mutex);
+    }
+
+    pthread_mutex_lock(&g_lock);
+    if(locked) {
+      waiter->state = WAITER_DONE;
+    } else {
+      waiter->wake_at = timer_now() + waiter->retry;
+      waiter->retry = waiter->retry < RETRY_MAX / 2 ? waiter->retry * 2 : RETRY_MAX;
+      // can't fail: it was just removed.
+      heap_push(waiter);
+      waiter->state = WAITER_QUEUED;
+    }
+    pthread_cond_broadcast(&g_fired);
+  }
+}
+
+static void* timer_thread(void* data) {
+  const size_t self = (size_t)(uintptr_t)data;
+
+  pthread_mutex_lock(&g_lock);
+  for(;;) {
+    fire_expired();
+
+    if(g_heap_count == 0 || covered(g_heap[0]->wake_at)) {
+      g_idle++;
+      pthread_cond_wait(&g_wake, &g_lock);
+      g_idle--;
+      continue;
+    }
+
+    const int64_t now = timer_now();
+    int64_t delta = g_heap[0]->wake_at - now;
+    if(delta <= 0) { continue; }
+    if(delta > SLEEP_HORIZON) { delta = SLEEP_HORIZON; }
+
+    g_sleeping_until[self] = now + delta;
+    pthread_mutex_unlock(&g_lock);
+    sleep_for(delta);
+    pthread_mutex_lock(&g_lock);
+    g_sleeping_until[self] = INT64_MAX;
+  }
+
+  return NULL;
+}
+
+// g_lock held. Gets a timer thread to look at the heap for a deadline nobody
+// sleeps towards; false if there's none to spare.
+static bool wake_sleeper(void) {
+  if(g_idle != 0) {
+    pthread_cond_signal(&g_wake);
+    return true;
+  }
+  if(g_threads == MAX_SLEEPERS) { return false; }
+
+  pthread_t thread;
+  g_sleeping_until[g_threads] = INT64_MAX;
+  if(pthread_create(&thread, NULL, timer_thread, (void*)(uintptr_t)g_threads) != 0) {
+    return false;
+  }
+  pthread_detach(thread);
+  g_threads++;
+  return true;
+}
+
+static void waiter_cleanup(void* data) {
+  waiter_t* waiter = data;
+
+  pthread_mutex_lock(&g_lock);
+  // Brief: the timer thread doesn't block while FIRING.
+  while(waiter->state == WAITER_FIRING) {
+    pthread_cond_wait(&g_fired, &g_lock);
+  }
+  if(waiter->state == WAITER_QUEUED) {
+    heap_remove(waiter);
+  }
+  waiter->state = WAITER_DONE;
+  pthread_mutex_unlock(&g_lock);
+}
+
+static int timer_timedwait(timer_cond_t* cond, timer_mutex_t* mutex, int64_t deadline) {
+  if(timer_now() >= deadline) { return ETIMEDOUT; }
+
+  waiter_t waiter = {
+    .cond = cond,
+    .mutex = mutex,
+    .wake_at = deadline + BACKSTOP_GRACE,
+    .retry = RETRY_MIN,
+    .state = WAITER_QUEUED,
+    .index = 0,
+  };
+
+  pthread_mutex_lock(&g_lock);
+  bool queued = heap_push(&waiter) == 0;
+  if(queued && !covered(waiter.wake_at) && !wake_sleeper()) {
+    heap_remove(&waiter);
+    queued = false;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  if(!queued) {
+    return translated_timedwait(cond, mutex, deadline);
+  }
+
+  // `waiter` lives on our stack, so take it out of the heap even when
+  // cancelled.
+  int err;
+  timer_cleanup_push(waiter_cleanup, &waiter);
+  do {
+    err = translated_timedwait(cond, mutex, deadline);
+  } while(err == ETIMEDOUT && timer_now() < deadline);
+  timer_cleanup_pop();
+  waiter_cleanup(&waiter);
+
+  return timer_now() >= deadline ? ETIMEDOUT : 0;
+}
+
+#ifdef PPAPI_TIMER_POSIX
+
+int vlc_ppapi_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, int64_t deadline) {
+  return timer_timedwait(cond, mutex, deadline);
+}
+
+#else
+
+// In parentheses, in case vlc_threads.h wraps these in macros.
+int (vlc_cond_timedwait)(vlc_cond_t* cond, vlc_mutex_t* mutex, mtime_t deadline) {
+  return timer_timedwait(cond, mutex, deadline);
+}
+
+typedef struct nap_t {
+  vlc_cond_t cond;
+  vlc_mutex_t lock;
+} nap_t;
+
+static void nap_cleanup(void* data) {
+  nap_t* nap = data;
+  vlc_mutex_unlock(&nap->lock);
+  vlc_cond_destroy(&nap->cond);
+  vlc_mutex_destroy(&nap->lock);
+}
+
+// NaCl has no pthread_cancel(), so vlc_cancel() can only interrupt a condition
+// wait; a relative sleep, immune to clock steps as it is, would hold up
+// cancelling the thread until it's over. So this waits on a condition variable
+// nobody signals, its own so a backstop firing only wakes this call up.
+void (mwait)(mtime_t deadline) {
+  nap_t nap;
+  vlc_cond_init(&nap.cond);
+  vlc_mutex_init(&nap.lock);
+
+  vlc_mutex_lock(&nap.lock);
+  vlc_cleanup_push(nap_cleanup, &nap);
+  while(timer_timedwait(&nap.cond, &nap.lock, deadline) == 0) {}
+  vlc_cleanup_pop();
+  nap_cleanup(&nap);
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file ppapi-timer.h
+ * @brief Host build of the monotonic timed waits, for the benchmark.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PPAPI_TIMER_H
+#define PPAPI_TIMER_H
+
+// Only for src/ppapi-timer.c built with PPAPI_TIMER_POSIX, ie by
+// extras/timedwait-bench.c. In the module, the same code is linked as vlc's
+// vlc_cond_timedwait() and mwait().
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Microseconds on CLOCK_MONOTONIC, ie the same clock as mdate().
+int64_t vlc_ppapi_mdate(void);
+// Same contract as pthread_cond_timedwait() (returns 0 or ETIMEDOUT, and may
+// wake spuriously), except that `deadline` is on the vlc_ppapi_mdate() clock.
+int vlc_ppapi_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, int64_t deadline);
+// Added to the next realtime deadline the calling thread translates, as if the
+// realtime clock had been set back that much right after; then reset to 0.
+// Stepping the clock for real needs root.
+extern __thread int64_t vlc_ppapi_realtime_skew;
+
+#endif
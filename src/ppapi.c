@@ -22,6 +22,8 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <math.h>
+#include <malloc.h>
 
 #include <vlc_common.h>
 #include <vlc_arrays.h>
@@ -29,6 +31,10 @@
 #include <vlc_atomic.h>
 #include <vlc_ppapi.h>
 
+#include <ppapi/c/ppb_opengles2.h>
+
+#include "ppapi.h"
+
 #define NULLABORT(msg, var) if (unlikely((var) == NULL)) {              \
     printf("`%s` is null! Aborting! (%s)",                              \
            msg, __func__);                                              \
@@ -58,6 +64,8 @@ static const vlc_ppapi_var_t*            g_var            = NULL;
 static const vlc_ppapi_var_array_t*      g_var_array      = NULL;
 static const vlc_ppapi_var_dictionary_t* g_var_dictionary = NULL;
 static const vlc_ppapi_view_t*           g_view           = NULL;
+// only handed out by name, to gl2ext_ppapi (see bin/ppapi.c).
+static const struct PPB_OpenGLES2*       g_opengles2      = NULL;
 
 const vlc_ppapi_audio_t* vlc_getPPAPI_Audio(void) {
   NULLABORT("PPB_Audio interface", g_audio);
@@ -138,8 +146,25 @@ const vlc_ppapi_view_t* vlc_getPPAPI_View(void) {
 
 static PPB_GetInterface g_get_interface = NULL;
 
+// Modules that ask for an interface by name get the same hooked copies as the
+// getters above return (see src/ppapi-hooks.c).
+static const void* get_hooked_interface(const char* name) {
+  if(strcmp(name, PPB_URLLOADER_INTERFACE_1_0) == 0) {
+    return g_url_loader;
+  } else if(strcmp(name, PPB_AUDIO_INTERFACE_1_1) == 0) {
+    return g_audio;
+  } else if(strcmp(name, PPB_GRAPHICS_3D_INTERFACE_1_0) == 0) {
+    return g_graphics_3d;
+  } else if(strcmp(name, PPB_MESSAGING_INTERFACE_1_2) == 0) {
+    return g_messaging;
+  } else if(strcmp(name, PPB_OPENGLES2_INTERFACE_1_0) == 0) {
+    return g_opengles2;
+  }
+  return g_get_interface(name);
+}
+
 PPB_GetInterface vlc_getPPBGetInstance(void) {
-  return g_get_interface;
+  return g_get_interface != NULL ? get_hooked_interface : NULL;
 }
 
 PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface);
@@ -147,18 +172,20 @@ PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface);
 PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface) {
   g_get_interface = get_interface;
 
+  // not vlc_getPPBGetInstance(), which hands out what's set here.
   PPB_GetInterface gi = get_interface;
 
-  g_audio = (const vlc_ppapi_audio_t*)vlc_getPPBGetInstance()(PPB_AUDIO_INTERFACE_1_1);
+  g_audio = (const vlc_ppapi_audio_t*)gi(PPB_AUDIO_INTERFACE_1_1);
   CHECKNULL("get PPB_Audio interface", g_audio, PP_FALSE);
 
-  g_audio_config = (const vlc_ppapi_audio_config_t*)vlc_getPPBGetInstance()(PPB_AUDIO_CONFIG_INTERFACE_1_1);
+  g_audio_config = (const vlc_ppapi_audio_config_t*)gi(PPB_AUDIO_CONFIG_INTERFACE_1_1);
   CHECKNULL("get PPB_AudioConfig interface", g_audio_config, PP_FALSE);
+  g_audio = vlc_ppapi_hook_audio(g_audio, g_audio_config);
 
-  g_console = (const vlc_ppapi_console_t*)vlc_getPPBGetInstance()(PPB_CONSOLE_INTERFACE_1_0);
+  g_console = (const vlc_ppapi_console_t*)gi(PPB_CONSOLE_INTERFACE_1_0);
   CHECKNULL("get PPB_Console interface", g_console, PP_FALSE);
 
-  g_core = (const vlc_ppapi_core_t*)vlc_getPPBGetInstance()(PPB_CORE_INTERFACE_1_0);
+  g_core = (const vlc_ppapi_core_t*)gi(PPB_CORE_INTERFACE_1_0);
   CHECKNULL("get PPB_Core interface", g_core, PP_FALSE);
 
   g_file_io = (const vlc_ppapi_file_io_t*)gi(PPB_FILEIO_INTERFACE_1_1);
@@ -168,25 +195,31 @@ PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface) {
   g_file_system = (const vlc_ppapi_file_system_t*)gi(PPB_FILESYSTEM_INTERFACE_1_0);
   CHECKNULL("get PPB_FileSystem interface", g_file_system, PP_FALSE);
 
-  g_graphics_3d = (const vlc_ppapi_graphics_3d_t*)vlc_getPPBGetInstance()(PPB_GRAPHICS_3D_INTERFACE_1_0);
+  g_graphics_3d = (const vlc_ppapi_graphics_3d_t*)gi(PPB_GRAPHICS_3D_INTERFACE_1_0);
   CHECKNULL("get PPB_Graphics3D interface", g_graphics_3d, PP_FALSE);
+  g_graphics_3d = vlc_ppapi_hook_graphics_3d(g_graphics_3d);
+  g_opengles2 = (const struct PPB_OpenGLES2*)gi(PPB_OPENGLES2_INTERFACE_1_0);
+  CHECKNULL("get PPB_OpenGLES2 interface", g_opengles2, PP_FALSE);
+  g_opengles2 = vlc_ppapi_hook_opengles2(g_opengles2);
 
   g_instance = (const vlc_ppapi_instance_t*)gi(PPB_INSTANCE_INTERFACE_1_0);
   CHECKNULL("get PPB_Instance interface", g_instance, PP_FALSE);
 
-  g_mouse_cursor = (const vlc_ppapi_mouse_cursor_t*)vlc_getPPBGetInstance()(PPB_MOUSECURSOR_INTERFACE_1_0);
+  g_mouse_cursor = (const vlc_ppapi_mouse_cursor_t*)gi(PPB_MOUSECURSOR_INTERFACE_1_0);
   CHECKNULL("get PPB_MouseInterface interface", g_mouse_cursor, PP_FALSE);
 
   g_message_loop = (const vlc_ppapi_message_loop_t*)gi(PPB_MESSAGELOOP_INTERFACE_1_0);
   CHECKNULL("get PPB_MessageLoop interface", g_mouse_cursor, PP_FALSE);
 
   g_messaging = (const vlc_ppapi_messaging_t*)gi(PPB_MESSAGING_INTERFACE_1_2);
-  CHECKNULL("get PPB_Messaging interface", g_mouse_cursor, PP_FALSE);
+  CHECKNULL("get PPB_Messaging interface", g_messaging, PP_FALSE);
+  g_messaging = vlc_ppapi_hook_messaging(g_messaging);
 
   g_url_loader = (const vlc_ppapi_url_loader_t*)gi(PPB_URLLOADER_INTERFACE_1_0);
-  CHECKNULL("get PPB_URLLoader interface", g_mouse_cursor, PP_FALSE);
+  CHECKNULL("get PPB_URLLoader interface", g_url_loader, PP_FALSE);
   g_url_request_info = (const vlc_ppapi_url_request_info_t*)gi(PPB_URLREQUESTINFO_INTERFACE_1_0);
-  CHECKNULL("get PPB_URLRequest interface", g_mouse_cursor, PP_FALSE);
+  CHECKNULL("get PPB_URLRequest interface", g_url_request_info, PP_FALSE);
+  g_url_loader = vlc_ppapi_hook_url_loader(g_url_loader, g_url_request_info);
   g_url_response_info = (const vlc_ppapi_url_response_info_t*)gi(PPB_URLRESPONSEINFO_INTERFACE_1_0);
   CHECKNULL("get PPB_URLResponse interface", g_mouse_cursor, PP_FALSE);
 
@@ -197,7 +230,7 @@ PP_Bool _internal_VLCInitializeGetInterface(PPB_GetInterface get_interface) {
   g_var_dictionary = (const vlc_ppapi_var_dictionary_t*)gi(PPB_VAR_DICTIONARY_INTERFACE_1_0);
   CHECKNULL("get PPB_VarDictionary interface", g_mouse_cursor, PP_FALSE);
 
-  g_view = (const vlc_ppapi_view_t*)vlc_getPPBGetInstance()(PPB_VIEW_INTERFACE_1_2);
+  g_view = (const vlc_ppapi_view_t*)gi(PPB_VIEW_INTERFACE_1_2);
   CHECKNULL("get PPB_View interface", g_view, PP_FALSE);
 
   return PP_TRUE;
@@ -303,6 +336,25 @@ void vlc_setPPAPI_InitializingInstance(PP_Instance instance) {
 }
 
 
+// Bandwidth samples are kept in a small ring; the estimate is an EWMA over
+// whatever is in it, so stale transfers age out on their own.
+#define BANDWIDTH_WINDOW 16
+
+typedef struct bandwidth_sample_t {
+  uint64_t bytes;
+  mtime_t duration;
+} bandwidth_sample_t;
+
+typedef struct bandwidth_state_t {
+  bandwidth_sample_t samples[BANDWIDTH_WINDOW];
+  size_t next_sample;
+  size_t sample_count;
+
+  // the last estimate posted as the `bandwidth` event, and when.
+  double reported_bps;
+  mtime_t reported_at;
+} bandwidth_state_t;
+
 typedef struct instance_data_t {
   PP_Instance instance;
 
@@ -314,6 +366,15 @@ typedef struct instance_data_t {
   int log_level;
 
   bool focus;
+
+  // `input-events`.
+  bool input_events;
+
+  // guarded by mtx, like everything else here.
+  bandwidth_state_t* bandwidth;
+
+  // atomic, so not guarded by mtx, and never replaced.
+  vlc_ppapi_stats_t* stats;
 } instance_data_t;
 
 static vlc_rwlock_t g_instance_data_mtx = VLC_STATIC_RWLOCK;
@@ -335,6 +396,14 @@ int32_t vlc_PPAPI_InitializeInstance(PP_Instance instance) {
 
   vlc_rwlock_t* mtx = malloc(sizeof(vlc_rwlock_t));
   if(mtx == NULL) { return VLC_ENOMEM; }
+  bandwidth_state_t* bandwidth = calloc(1, sizeof(bandwidth_state_t));
+  vlc_ppapi_stats_t* stats = vlc_ppapi_stats_new(instance);
+  if(bandwidth == NULL || stats == NULL) {
+    vlc_ppapi_stats_delete(stats);
+    free(bandwidth);
+    free(mtx);
+    return VLC_ENOMEM;
+  }
   vlc_rwlock_init(mtx);
 
   instance_data_t data = {
@@ -343,6 +412,9 @@ int32_t vlc_PPAPI_InitializeInstance(PP_Instance instance) {
     0,
     3, // LIBVLC_WARNING
     true,
+    false,
+    bandwidth,
+    stats,
   };
 
   vlc_rwlock_wrlock(&g_instance_data_mtx);
@@ -369,6 +441,9 @@ void vlc_PPAPI_DeinitializeInstance(PP_Instance instance) {
     vlc_rwlock_unlock(item.mtx);
     vlc_rwlock_destroy(item.mtx);
     free(item.mtx);
+    free(item.bandwidth);
+    vlc_ppapi_stats_delete(item.stats);
+    vlc_ppapi_hooks_forget_instance(instance);
 
     return;
   }
@@ -473,3 +548,238 @@ bool vlc_getPPAPI_InstanceFocus(PP_Instance instance) {
   vlc_rwlock_unlock(&g_instance_data_mtx);
   return result;
 }
+
+// Half lives, in seconds, of the two averages. The fast one follows drops
+// quickly, the slow one keeps a single burst from looking like the norm; the
+// estimate is whichever is lower.
+#define BANDWIDTH_FAST_HALF_LIFE 2.0
+#define BANDWIDTH_SLOW_HALF_LIFE 5.0
+// Transfers smaller than this mostly measure latency, not throughput.
+#define BANDWIDTH_MIN_SAMPLE_BYTES (16 * 1024)
+// Don't post the `bandwidth` event for every sample:
+#define BANDWIDTH_REPORT_INTERVAL CLOCK_FREQ
+#define BANDWIDTH_REPORT_CHANGE 0.1
+
+static double ewma_bandwidth(const bandwidth_state_t* bw, const double half_life) {
+  double estimate = 0.0, weight = 0.0;
+
+  const size_t first = (bw->next_sample + BANDWIDTH_WINDOW - bw->sample_count) % BANDWIDTH_WINDOW;
+  for(size_t i = 0; i < bw->sample_count; i++) {
+    const bandwidth_sample_t* sample = &bw->samples[(first + i) % BANDWIDTH_WINDOW];
+    const double seconds = (double)sample->duration / CLOCK_FREQ;
+    const double bps = (double)sample->bytes * 8.0 / seconds;
+    const double alpha = 1.0 - pow(0.5, seconds / half_life);
+
+    estimate = alpha * bps + (1.0 - alpha) * estimate;
+    weight = alpha + (1.0 - alpha) * weight;
+  }
+
+  // `weight` is < 1 until enough time has been sampled; dividing it out keeps
+  // the first few samples from being biased towards zero.
+  return weight > 0.0 ? estimate / weight : 0.0;
+}
+
+static double estimate_bandwidth(const bandwidth_state_t* bw) {
+  const double fast = ewma_bandwidth(bw, BANDWIDTH_FAST_HALF_LIFE);
+  const double slow = ewma_bandwidth(bw, BANDWIDTH_SLOW_HALF_LIFE);
+  return fast < slow ? fast : slow;
+}
+
+void vlc_ppapi_bandwidth_sample(PP_Instance instance, uint64_t bytes, mtime_t duration) {
+  assert(instance != 0);
+  if(bytes < BANDWIDTH_MIN_SAMPLE_BYTES || duration <= 0) { return; }
+
+  const mtime_t now = mdate();
+  double report = -1.0;
+
+  vlc_rwlock_rdlock(&g_instance_data_mtx);
+  for(size_t i = 0; i < (size_t)g_instance_data.i_size; i++) {
+    instance_data_t* item = &ARRAY_VAL(g_instance_data, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    vlc_rwlock_wrlock(item->mtx);
+    bandwidth_state_t* bw = item->bandwidth;
+    bw->samples[bw->next_sample].bytes = bytes;
+    bw->samples[bw->next_sample].duration = duration;
+    bw->next_sample = (bw->next_sample + 1) % BANDWIDTH_WINDOW;
+    if(bw->sample_count < BANDWIDTH_WINDOW) { bw->sample_count++; }
+
+    if(item->input_events && now - bw->reported_at >= BANDWIDTH_REPORT_INTERVAL) {
+      const double estimate = estimate_bandwidth(bw);
+      if(fabs(estimate - bw->reported_bps) > bw->reported_bps * BANDWIDTH_REPORT_CHANGE) {
+        bw->reported_bps = estimate;
+        bw->reported_at = now;
+        report = estimate;
+      }
+    }
+    vlc_rwlock_unlock(item->mtx);
+    break;
+  }
+  vlc_rwlock_unlock(&g_instance_data_mtx);
+
+  if(report >= 0.0) {
+    vlc_ppapi_post_input_event(instance, "bandwidth", PP_MakeDouble(report));
+  }
+}
+
+double vlc_ppapi_bandwidth_estimate(PP_Instance instance) {
+  assert(instance != 0);
+  double result = 0.0;
+
+  vlc_rwlock_rdlock(&g_instance_data_mtx);
+  for(size_t i = 0; i < (size_t)g_instance_data.i_size; i++) {
+    instance_data_t* item = &ARRAY_VAL(g_instance_data, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    vlc_rwlock_rdlock(item->mtx);
+    result = estimate_bandwidth(item->bandwidth);
+    vlc_rwlock_unlock(item->mtx);
+    break;
+  }
+  vlc_rwlock_unlock(&g_instance_data_mtx);
+  return result;
+}
+
+void vlc_ppapi_input_events_enable(PP_Instance instance) {
+  assert(instance != 0);
+  vlc_rwlock_rdlock(&g_instance_data_mtx);
+  for(size_t i = 0; i < (size_t)g_instance_data.i_size; i++) {
+    instance_data_t* item = &ARRAY_VAL(g_instance_data, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    vlc_rwlock_wrlock(item->mtx);
+    item->input_events = true;
+    vlc_rwlock_unlock(item->mtx);
+    break;
+  }
+  vlc_rwlock_unlock(&g_instance_data_mtx);
+}
+
+bool vlc_ppapi_input_events_enabled(PP_Instance instance) {
+  assert(instance != 0);
+  bool result = false;
+  vlc_rwlock_rdlock(&g_instance_data_mtx);
+  for(size_t i = 0; i < (size_t)g_instance_data.i_size; i++) {
+    instance_data_t* item = &ARRAY_VAL(g_instance_data, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    vlc_rwlock_rdlock(item->mtx);
+    result = item->input_events;
+    vlc_rwlock_unlock(item->mtx);
+    break;
+  }
+  vlc_rwlock_unlock(&g_instance_data_mtx);
+  return result;
+}
+
+// Same shape as the events ppapi_control posts, so ppapi-control.js dispatches
+// them to the `input` object's listeners.
+void vlc_ppapi_post_input_event(PP_Instance instance, const char* name, PP_Var value) {
+  VLC_PPAPI_STATIC_STR(type_key, "type");
+  VLC_PPAPI_STATIC_STR(type_event, "event");
+  VLC_PPAPI_STATIC_STR(location_key, "location");
+  VLC_PPAPI_STATIC_STR(value_key, "value");
+
+  assert(instance != 0 && name != NULL);
+
+  char location[64];
+  const int location_len = snprintf(location, sizeof(location), "/input/event/%s()", name);
+  assert(location_len > 0 && (size_t)location_len < sizeof(location));
+  PP_Var location_var = vlc_ppapi_cstr_to_var(location, location_len);
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+  PP_Var msg = idict->Create();
+  idict->Set(msg, vlc_ppapi_mk_str(&type_key), vlc_ppapi_mk_str(&type_event));
+  idict->Set(msg, vlc_ppapi_mk_str(&location_key), location_var);
+  idict->Set(msg, vlc_ppapi_mk_str(&value_key), value);
+
+  vlc_getPPAPI_Messaging()->PostMessage(instance, msg);
+
+  vlc_ppapi_deref_var(location_var);
+  vlc_ppapi_deref_var(msg);
+}
+
+// Pressure starts at 90% of the budget and lasts until usage is back under
+// 75%, so usage hovering around the threshold doesn't flap.
+#define MEM_PRESSURE_ON(budget)  ((budget) / 10 * 9)
+#define MEM_PRESSURE_OFF(budget) ((budget) / 4 * 3)
+
+// MAY ONLY BE ACCESSED FROM THE MAIN THREAD.
+static struct {
+  int64_t used;
+  int64_t peak;
+  int64_t budget;
+  bool pressure;
+} g_mem = { 0, 0, 0, false };
+
+bool vlc_ppapi_mem_sample(int64_t budget) {
+  assert(budget >= 0);
+
+  // what's handed out, whether from the heap proper or mmapped.
+  const struct mallinfo info = mallinfo();
+  const int64_t used = (int64_t)(unsigned)info.uordblks + (int64_t)(unsigned)info.hblkhd;
+
+  g_mem.used = used;
+  if(used > g_mem.peak) {
+    g_mem.peak = used;
+  }
+  g_mem.budget = budget;
+
+  bool pressure = g_mem.pressure;
+  if(budget == 0) {
+    pressure = false;
+  } else if(!pressure && used >= MEM_PRESSURE_ON(budget)) {
+    pressure = true;
+  } else if(pressure && used < MEM_PRESSURE_OFF(budget)) {
+    pressure = false;
+  }
+
+  const bool changed = pressure != g_mem.pressure;
+  g_mem.pressure = pressure;
+  return changed;
+}
+
+bool vlc_ppapi_mem_under_pressure(void) {
+  return g_mem.pressure;
+}
+
+PP_Var vlc_ppapi_mem_stats(void) {
+  VLC_PPAPI_STATIC_STR(used_key, "used");
+  VLC_PPAPI_STATIC_STR(peak_key, "peak");
+  VLC_PPAPI_STATIC_STR(budget_key, "budget");
+  VLC_PPAPI_STATIC_STR(pressure_key, "pressure");
+
+  const vlc_ppapi_var_dictionary_t* idict = vlc_getPPAPI_VarDictionary();
+  PP_Var stats = idict->Create();
+  // doubles, as JS numbers can't hold all of an int64_t anyway.
+  idict->Set(stats, vlc_ppapi_mk_str(&used_key), PP_MakeDouble((double)g_mem.used));
+  idict->Set(stats, vlc_ppapi_mk_str(&peak_key), PP_MakeDouble((double)g_mem.peak));
+  idict->Set(stats, vlc_ppapi_mk_str(&budget_key), PP_MakeDouble((double)g_mem.budget));
+  idict->Set(stats, vlc_ppapi_mk_str(&pressure_key), PP_MakeBool(PP_FromBool(g_mem.pressure)));
+  return stats;
+}
+
+vlc_ppapi_stats_t* vlc_ppapi_get_stats(PP_Instance instance) {
+  assert(instance != 0);
+  vlc_rwlock_rdlock(&g_instance_data_mtx);
+  vlc_ppapi_stats_t* result = NULL;
+  for(size_t i = 0; i < (size_t)g_instance_data.i_size; i++) {
+    instance_data_t* item = &ARRAY_VAL(g_instance_data, i);
+    if(item->instance != instance) {
+      continue;
+    }
+
+    result = item->stats;
+    break;
+  }
+  vlc_rwlock_unlock(&g_instance_data_mtx);
+  return result;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file ppapi.h
+ * @brief Declares this project's additions to vlc_ppapi.h, ie what the
+ * modules in src/ and bin/ppapi.c share.
+ */
+/*****************************************************************************
+ * Copyright © 2015 Cadonix, Richard Diamond
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PPAPI_H
+#define PPAPI_H
+
+#include <vlc_common.h>
+#include <vlc_ppapi.h>
+
+/* src/ppapi-document.c */
+
+// Takes a reference to loader. Replaces any document of the instance that
+// hasn't been opened yet.
+void vlc_ppapi_set_document_loader(PP_Instance instance, PP_Resource loader);
+// The caller owns the returned reference. Returns 0 if there is none.
+PP_Resource vlc_ppapi_take_document_loader(PP_Instance instance);
+
+/* src/ppapi-hooks.c */
+
+// Returns a copy of `loader` whose calls are measured: requests record their
+// download progress, which feeds the bandwidth estimator of their instance, and
+// each is posted as a `transfer` event if the instance wants input events.
+// Called once, by src/ppapi.c, before any module runs.
+const vlc_ppapi_url_loader_t* vlc_ppapi_hook_url_loader(const vlc_ppapi_url_loader_t* loader,
+                                                        const vlc_ppapi_url_request_info_t* request_info);
+// The rest measure the hot paths into the instance's stats (see
+// src/ppapi-stats.c): message dispatch, audio callbacks, swaps and texture
+// uploads.
+const vlc_ppapi_messaging_t* vlc_ppapi_hook_messaging(const vlc_ppapi_messaging_t* messaging);
+const vlc_ppapi_audio_t* vlc_ppapi_hook_audio(const vlc_ppapi_audio_t* audio,
+                                              const vlc_ppapi_audio_config_t* audio_config);
+const vlc_ppapi_graphics_3d_t* vlc_ppapi_hook_graphics_3d(const vlc_ppapi_graphics_3d_t* graphics_3d);
+struct PPB_OpenGLES2;
+const struct PPB_OpenGLES2* vlc_ppapi_hook_opengles2(const struct PPB_OpenGLES2* opengles2);
+// Drops what's still tracked for the instance's resources.
+void vlc_ppapi_hooks_forget_instance(PP_Instance instance);
+
+/* src/ppapi.c: bandwidth estimation */
+
+// Feed the estimator of instance with one transfer: `bytes` received over
+// `duration` of wall-clock time. Safe to call from any thread.
+void vlc_ppapi_bandwidth_sample(PP_Instance instance, uint64_t bytes, mtime_t duration);
+// Returns the current estimate in bits per second, or 0 if nothing has been
+// sampled yet. Posted to the page in the `stats` message, and as the
+// `bandwidth` event if the instance wants input events.
+double vlc_ppapi_bandwidth_estimate(PP_Instance instance);
+
+/* src/ppapi.c: input events the module posts itself */
+
+// Opt in (the `input-events` <embed> attribute); off by default.
+void vlc_ppapi_input_events_enable(PP_Instance instance);
+bool vlc_ppapi_input_events_enabled(PP_Instance instance);
+// Posts `value` as the input event `name` (ie `/input/event/<name>()`),
+// whether or not the instance opted in: check first. Safe to call from any
+// thread.
+void vlc_ppapi_post_input_event(PP_Instance instance, const char* name, PP_Var value);
+
+/* src/ppapi.c: heap high-water mark (`memory-budget`) */
+
+// Instances share one heap, and nothing below libvlc's API knows which
+// instance an allocation is for, so usage is that of the whole module, as the
+// allocator reports it. All of these MAY ONLY BE CALLED FROM THE MAIN THREAD.
+
+// Re-reads the heap usage and checks it against `budget` (0 meaning none).
+// Returns true when that entered or left pressure.
+bool vlc_ppapi_mem_sample(int64_t budget);
+// True once the module is close to its budget: what can work with less (ie the
+// prebuffering of new inputs) should ask for less.
+bool vlc_ppapi_mem_under_pressure(void);
+// A dictionary of the last sample.
+PP_Var vlc_ppapi_mem_stats(void);
+
+/* src/ppapi-stats.c */
+
+typedef enum vlc_ppapi_stat_t {
+  // counters:
+  VLC_PPAPI_STATS_LOG_DROPPED,
+  // these three are counted by src/ppapi-hooks.c:
+  VLC_PPAPI_STATS_MESSAGES,
+  VLC_PPAPI_STATS_AUDIO_UNDERRUNS,
+  VLC_PPAPI_STATS_FRAMES_LATE,
+  // gauges:
+  VLC_PPAPI_STATS_CACHE_FILL, // permille
+
+  VLC_PPAPI_STATS_COUNT,
+} vlc_ppapi_stat_t;
+
+// Owned by the instance data in src/ppapi.c, and valid until the instance is
+// destroyed, ie for as long as the instance's modules are open. Look it up
+// once (ie when a module opens) and keep it: updates are lock free and cheap
+// enough for the hot paths.
+typedef struct vlc_ppapi_stats_t vlc_ppapi_stats_t;
+
+vlc_ppapi_stats_t* vlc_ppapi_get_stats(PP_Instance instance);
+// The instance stats belongs to, so callbacks can be given just the handle.
+PP_Instance vlc_ppapi_stats_instance(const vlc_ppapi_stats_t* stats);
+
+vlc_ppapi_stats_t* vlc_ppapi_stats_new(PP_Instance instance);
+void vlc_ppapi_stats_delete(vlc_ppapi_stats_t* stats);
+
+// Both are no-ops if stats is NULL.
+void vlc_ppapi_stats_add(vlc_ppapi_stats_t* stats, vlc_ppapi_stat_t stat, int64_t delta);
+void vlc_ppapi_stats_set(vlc_ppapi_stats_t* stats, vlc_ppapi_stat_t stat, int64_t value);
+// A dictionary of every counter, and whether tracing is on. bin/ppapi.c adds
+// what libvlc knows to it and posts it as the `stats` message.
+PP_Var vlc_ppapi_stats_to_var(vlc_ppapi_stats_t* stats);
+
+// Tracing is opt in (see the `trace` <embed> attribute): spans are recorded in
+// a ring of `capacity` events, the oldest being overwritten.
+int vlc_ppapi_trace_enable(vlc_ppapi_stats_t* stats, size_t capacity);
+// Returns 0 when not tracing, which vlc_ppapi_trace_end ignores, so spans cost
+// next to nothing when tracing is off. `name` must outlive the instance (ie be
+// a literal):
+//   const mtime_t span = vlc_ppapi_trace_begin(stats);
+//   ...
+//   vlc_ppapi_trace_end(stats, "decode", span);
+mtime_t vlc_ppapi_trace_begin(vlc_ppapi_stats_t* stats);
+void vlc_ppapi_trace_end(vlc_ppapi_stats_t* stats, const char* name, mtime_t start);
+// Posts the ring to the page as a `trace` message of Chrome trace-event JSON
+// (loadable in about:tracing).
+int vlc_ppapi_trace_post(vlc_ppapi_stats_t* stats);
+
+#endif